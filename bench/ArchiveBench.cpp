@@ -0,0 +1,66 @@
+#include "Bench.hpp"
+#include <ShaderTranspiler/ShaderTranspiler.hpp>
+#include <filesystem>
+#include <iostream>
+
+using namespace std;
+using namespace shadert;
+
+int bench::RunArchiveBench(){
+	const MemoryCompileTask task{R"(#version 460
+		layout(location = 0) in vec3 position;
+		layout(location = 1) in vec2 uv;
+		layout(location = 0) out vec2 outUV;
+		layout(binding = 0) uniform Camera { mat4 viewProj; } camera;
+		layout(binding = 1) uniform sampler2D heightmap;
+		void main(){
+			outUV = uv;
+			gl_Position = camera.viewProj * vec4(position + vec3(0, textureLod(heightmap, uv, 0.0).r, 0), 1);
+		}
+	)", "terrain.vert", ShaderStage::Vertex};
+	Options opt;
+	opt.version = 16;
+	opt.mobile = false;
+	opt.debug = true;
+	ShaderTranspiler transpiler;
+	const auto result = transpiler.CompileTo(task, TargetAPI::Vulkan, opt);
+
+	// one entry per variant, as a game would ship them
+	constexpr size_t numEntries = 4096;
+	ShaderArchiveWriter writer;
+	for (size_t i = 0; i < numEntries; i++){
+		writer.Add("terrain.vert/" + to_string(i), result);
+	}
+	const auto path = filesystem::temp_directory_path() / "ShaderTranspilerBench.star";
+	writer.Write(path);
+
+	ShaderArchive archive;
+	const double openUs = MedianMicroseconds(20, [&]{
+		archive = ShaderArchive::Open(path);
+	});
+	vector<string> keys;
+	for (size_t i = 0; i < numEntries; i++){
+		keys.push_back("terrain.vert/" + to_string((i * 2654435761u) % numEntries));
+	}
+
+	size_t checksum = 0;
+	const double findUs = MedianMicroseconds(20, [&]{
+		for (const auto& key : keys){
+			auto shader = archive.Find(key);
+			checksum += shader->SpirvWords().size() + shader->Reflection().Size(ReflectionView::ResourceType::StageInputs);
+		}
+	});
+	const double copyUs = MedianMicroseconds(20, [&]{
+		for (const auto& key : keys){
+			checksum += archive.Find(key)->ToCompileResult().data.binaryData.size();
+		}
+	});
+	const auto bytes = filesystem::file_size(path);
+	archive = {};
+	filesystem::remove(path);
+
+	const bool ok = checksum > 0;
+	cout << "archive entries=" << numEntries << " bytes=" << bytes
+		<< " open_us=" << openUs << " find_view_ns=" << findUs * 1000 / numEntries << " find_copy_ns=" << copyUs * 1000 / numEntries << endl;
+	return ok ? 0 : 1;
+}
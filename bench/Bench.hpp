@@ -0,0 +1,93 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+#include <ShaderTranspiler/ShaderTranspiler.hpp>
+
+namespace bench{
+
+/**
+ Run a function repeatedly
+ @param iterations how many times to run it
+ @param fn the function to time
+ @return the median wall time of one run, in microseconds
+ */
+template<typename fn_t>
+double MedianMicroseconds(size_t iterations, fn_t&& fn){
+	std::vector<double> samples;
+	samples.reserve(iterations);
+	for (size_t i = 0; i < iterations; i++){
+		auto start = std::chrono::steady_clock::now();
+		fn();
+		auto end = std::chrono::steady_clock::now();
+		samples.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+	}
+	std::sort(samples.begin(), samples.end());
+	return samples[samples.size() / 2];
+}
+
+/**
+ @param samples the measurements, in any order
+ @param percentile from 0 to 100
+ @return the sample at that percentile, by the nearest-rank method
+ */
+inline double Percentile(std::vector<double> samples, double percentile){
+	if (samples.empty()){
+		return 0;
+	}
+	std::sort(samples.begin(), samples.end());
+	const auto rank = size_t(std::ceil(percentile / 100 * samples.size()));
+	return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+}
+
+/**
+ Copy the binaryData of a Vulkan CompileResult into SPIR-V words
+ */
+inline std::vector<uint32_t> ToWords(const shadert::BinaryBuffer& binary){
+	const auto words = binary.Words();
+	return {words.begin(), words.end()};
+}
+
+struct ShaderShape{
+	const char* name;
+	int inputs, outputs, uniformBuffers, textures, storageBuffers, statements;
+};
+
+/**
+ Generate a vertex shader with the given number of resources. Interface variables are declared in reverse location
+ order so that reflection has to reorder them.
+ */
+std::string GenerateShader(const ShaderShape& shape);
+
+inline constexpr ShaderShape shaderShapes[] = {
+	{"small", 4, 4, 1, 2, 1, 16},
+	{"medium", 16, 16, 8, 8, 4, 500},
+	{"large", 32, 30, 32, 32, 16, 5000},
+};
+
+struct CorpusShader{
+	std::filesystem::path path;
+	shadert::ShaderStage stage;
+};
+
+/**
+ @return every shader in bench/corpus, by name. The stage comes from the extension.
+ */
+std::vector<CorpusShader> LoadCorpus();
+
+/**
+ @return the name of a stage with spaces replaced, so that it can be a value in key=value output
+ */
+std::string StageKey(shadert::CompileStage stage);
+
+int RunReflectionBench();
+int RunArchiveBench();
+int RunOptimizationBench();
+int RunCorpusBench();
+int RunScalingBench();
+
+}
@@ -0,0 +1,138 @@
+#include "Bench.hpp"
+#include <ShaderTranspiler/ShaderTranspiler.hpp>
+#include <iostream>
+#include <map>
+
+using namespace std;
+using namespace shadert;
+
+vector<bench::CorpusShader> bench::LoadCorpus(){
+	const map<string, ShaderStage> extensions{
+		{".vert", ShaderStage::Vertex},
+		{".frag", ShaderStage::Fragment},
+		{".comp", ShaderStage::Compute},
+	};
+	vector<CorpusShader> shaders;
+	for (const auto& entry : filesystem::directory_iterator(ST_BENCH_CORPUS_DIR)){
+		if (auto it = extensions.find(entry.path().extension().string()); entry.is_regular_file() && it != extensions.end()){
+			shaders.push_back({entry.path(), it->second});
+		}
+	}
+	sort(shaders.begin(), shaders.end(), [](const auto& a, const auto& b){
+		return a.path < b.path;
+	});
+	return shaders;
+}
+
+string bench::StageKey(CompileStage stage){
+	string name = StageName(stage);
+	replace(name.begin(), name.end(), ' ', '_');
+	return name;
+}
+
+namespace {
+
+void printPercentiles(const vector<double>& samples){
+	cout << " p50_us=" << bench::Percentile(samples, 50) << " p90_us=" << bench::Percentile(samples, 90) << " p99_us=" << bench::Percentile(samples, 99);
+}
+
+}
+
+int bench::RunCorpusBench(){
+	struct Target{
+		const char* name;
+		TargetAPI api;
+		uint32_t version;
+	};
+	const Target targets[] = {
+		{"Vulkan", TargetAPI::Vulkan, 16},
+		{"OpenGL", TargetAPI::OpenGL, 410},
+		{"HLSL", TargetAPI::HLSL, 62},
+		{"Metal", TargetAPI::Metal, 30},
+	};
+	constexpr size_t iterations = 10;
+	constexpr size_t throughputRounds = 3;
+
+	const auto corpus = LoadCorpus();
+	if (corpus.empty()){
+		cerr << "corpus error=no shaders in " << ST_BENCH_CORPUS_DIR << endl;
+		return 1;
+	}
+	ShaderTranspiler::WarmUp({ShaderStage::Vertex, ShaderStage::Fragment, ShaderStage::Compute});
+
+	ShaderTranspiler transpiler;
+	int status = 0;
+	for (const auto& target : targets){
+		Options opt;
+		opt.version = target.version;
+		opt.mobile = false;
+		opt.entryPoint = "main";
+		opt.collectStats = true;
+
+		// latency of each shader, one compile at a time
+		vector<double> targetTotals;
+		array<vector<double>, size_t(CompileStage::Count)> targetStages;
+		for (const auto& shader : corpus){
+			const auto name = shader.path.filename().string();
+			const FileCompileTask task{shader.path, shader.stage};
+			vector<double> totals;
+			CompileStats stats;
+			try{
+				transpiler.CompileTo(task, target.api, opt);	// not measured, the first compile fills the include cache
+				for (size_t i = 0; i < iterations; i++){
+					stats = *transpiler.CompileTo(task, target.api, opt).stats;
+					totals.push_back(chrono::duration<double, micro>(stats.total).count());
+					for (size_t stage = 0; stage < targetStages.size(); stage++){
+						if (stats.stageDurations[stage].count() > 0){
+							targetStages[stage].push_back(chrono::duration<double, micro>(stats.stageDurations[stage]).count());
+						}
+					}
+				}
+			}
+			catch(exception& e){
+				cerr << "corpus shader=" << name << " target=" << target.name << " error=" << e.what() << endl;
+				status = 1;
+				continue;
+			}
+			targetTotals.insert(targetTotals.end(), totals.begin(), totals.end());
+			cout << "corpus shader=" << name << " target=" << target.name << " iterations=" << iterations;
+			printPercentiles(totals);
+			cout << " input_bytes=" << stats.inputBytes << " output_bytes=" << stats.outputBytes << " spirv_words=" << stats.spirvWords
+				<< " optimized_spirv_words=" << stats.optimizedSpirvWords << " includes=" << stats.includeCount << endl;
+		}
+
+		cout << "corpus_target target=" << target.name << " compiles=" << targetTotals.size();
+		printPercentiles(targetTotals);
+		cout << endl;
+		for (size_t stage = 0; stage < targetStages.size(); stage++){
+			if (targetStages[stage].empty()){
+				continue;
+			}
+			cout << "corpus_stage target=" << target.name << " stage=" << StageKey(CompileStage(stage)) << " samples=" << targetStages[stage].size();
+			printPercentiles(targetStages[stage]);
+			cout << endl;
+		}
+
+		// throughput of the whole corpus as one batch on the library's thread pool
+		opt.collectStats = false;
+		vector<CompileJob> jobs;
+		for (const auto& shader : corpus){
+			jobs.push_back({FileCompileTask{shader.path, shader.stage}, target.api, opt});
+		}
+		size_t failed = 0;
+		const auto start = chrono::steady_clock::now();
+		for (size_t round = 0; round < throughputRounds; round++){
+			for (const auto& result : transpiler.CompileBatch(jobs)){
+				failed += !result.succeeded;
+			}
+		}
+		const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		const size_t compiled = jobs.size() * throughputRounds;
+		cout << "corpus_throughput target=" << target.name << " shaders=" << compiled << " failed=" << failed << " seconds=" << seconds
+			<< " shaders_per_second=" << compiled / seconds << endl;
+		if (failed > 0){
+			status = 1;
+		}
+	}
+	return status;
+}
@@ -0,0 +1,68 @@
+#include "Bench.hpp"
+#include <ShaderTranspiler/ShaderTranspiler.hpp>
+#include <iostream>
+
+using namespace std;
+using namespace shadert;
+
+int bench::RunOptimizationBench(){
+	struct Target{
+		const char* name;
+		TargetAPI api;
+		uint32_t version;
+	};
+	const Target targets[] = {
+		{"Vulkan", TargetAPI::Vulkan, 16},
+		{"OpenGL", TargetAPI::OpenGL, 410},
+		{"HLSL", TargetAPI::HLSL, 62},
+		{"Metal", TargetAPI::Metal, 30},
+	};
+	struct Level{
+		const char* name;
+		OptimizationLevel level;
+	};
+	const Level levels[] = {
+		{"none", OptimizationLevel::None},
+		{"default", OptimizationLevel::Default},
+		{"size", OptimizationLevel::Size},
+		{"performance", OptimizationLevel::Performance},
+	};
+
+	ShaderTranspiler transpiler;
+	int status = 0;
+	for (const auto& shape : shaderShapes){
+		const MemoryCompileTask task{GenerateShader(shape), string(shape.name) + ".vert", ShaderStage::Vertex};
+		// -Os takes seconds on the large shader
+		const size_t iterations = shape.statements > 1000 ? 1 : 5;
+		for (const auto& target : targets){
+			size_t unoptimizedBytes = 0;
+			for (const auto& level : levels){
+				Options opt;
+				opt.version = target.version;
+				opt.mobile = false;
+				opt.entryPoint = "main";
+				opt.optimization = level.level;
+
+				size_t bytes = 0;
+				double compileUs = 0;
+				try{
+					compileUs = MedianMicroseconds(iterations, [&]{
+						const auto result = transpiler.CompileTo(task, target.api, opt);
+						bytes = result.data.sourceData.size() + result.data.binaryData.size();
+					});
+				}
+				catch(exception& e){
+					cerr << "optimization shader=" << shape.name << " target=" << target.name << " level=" << level.name << " error=" << e.what() << endl;
+					status = 1;
+					continue;
+				}
+				if (level.level == OptimizationLevel::None){
+					unoptimizedBytes = bytes;
+				}
+				cout << "optimization shader=" << shape.name << " target=" << target.name << " level=" << level.name << " compile_us=" << compileUs
+					<< " bytes=" << bytes << " size_ratio=" << double(bytes) / unoptimizedBytes << endl;
+			}
+		}
+	}
+	return status;
+}
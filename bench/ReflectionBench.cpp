@@ -0,0 +1,141 @@
+#include "Bench.hpp"
+#include <ShaderTranspiler/ShaderTranspiler.hpp>
+#include "Reflection.hpp"
+#include <spirv_cross.hpp>
+#include <spirv_reflect.h>
+#include <iostream>
+#include <unordered_map>
+
+using namespace std;
+using namespace shadert;
+
+namespace {
+
+/**
+ The reflection the library used before ReflectSPIRV: SPIRV-Cross for the resources,
+ then a second full SPIRV-Reflect parse to recover the locations of the stage inputs and outputs
+ */
+ReflectData legacyReflectData(const spirv_cross::Compiler& comp, const spirvbytes& spirvdata){
+	auto rsc = comp.get_shader_resources();
+	ReflectData refl{
+		.uniform_buffers{rsc.uniform_buffers.begin(), rsc.uniform_buffers.end()},
+		.storage_buffers{rsc.storage_buffers.begin(), rsc.storage_buffers.end()},
+		.stage_inputs{rsc.stage_inputs.begin(), rsc.stage_inputs.end()},
+		.stage_outputs{rsc.stage_outputs.begin(), rsc.stage_outputs.end()},
+		.subpass_inputs{rsc.subpass_inputs.begin(), rsc.subpass_inputs.end()},
+		.storage_images{rsc.storage_images.begin(), rsc.storage_images.end()},
+		.sampled_images{rsc.sampled_images.begin(), rsc.sampled_images.end()},
+		.atomic_counters{rsc.atomic_counters.begin(), rsc.atomic_counters.end()},
+		.acceleration_structures{rsc.acceleration_structures.begin(), rsc.acceleration_structures.end()},
+		.push_constant_buffers{rsc.push_constant_buffers.begin(), rsc.push_constant_buffers.end()},
+		.separate_images{rsc.separate_images.begin(), rsc.separate_images.end()},
+		.separate_samplers{rsc.separate_samplers.begin(), rsc.separate_samplers.end()},
+	};
+
+	SpvReflectShaderModule spvModule;
+	if (spvReflectCreateShaderModule(spirvdata.size() * sizeof(spirvdata[0]), spirvdata.data(), &spvModule) != SPV_REFLECT_RESULT_SUCCESS){
+		throw runtime_error("SPIRV reflection capture failed");
+	}
+
+	const auto sortfn = [](const auto& spvreflvars, auto& inoutscontainer){
+		std::unordered_map<std::string_view, uint16_t> varToPos;
+		for (const auto& var : spvreflvars){
+			if (var->name != nullptr){
+				varToPos[var->name] = var->location;
+			}
+		}
+		std::sort(inoutscontainer.begin(), inoutscontainer.end(), [&](const auto& a, const auto& b){
+			return varToPos[a.name] < varToPos[b.name];
+		});
+	};
+
+	uint32_t count = 0;
+	spvReflectEnumerateInputVariables(&spvModule, &count, nullptr);
+	std::vector<SpvReflectInterfaceVariable*> inputs(count);
+	spvReflectEnumerateInputVariables(&spvModule, &count, inputs.data());
+	sortfn(inputs, refl.stage_inputs);
+
+	spvReflectEnumerateOutputVariables(&spvModule, &count, nullptr);
+	std::vector<SpvReflectInterfaceVariable*> outputs(count);
+	spvReflectEnumerateOutputVariables(&spvModule, &count, outputs.data());
+	sortfn(outputs, refl.stage_outputs);
+
+	for (int i = 0; i < 3; i++){
+		refl.compute_dim[i] = comp.get_execution_mode_argument(spv::ExecutionModeLocalSize, i);
+	}
+	spvReflectDestroyShaderModule(&spvModule);
+	return refl;
+}
+
+bool sameResources(const ReflectData& a, const ReflectData& b){
+	auto lists = [](const ReflectData& r){
+		return std::array{&r.uniform_buffers, &r.storage_buffers, &r.stage_inputs, &r.stage_outputs, &r.subpass_inputs, &r.storage_images,
+			&r.sampled_images, &r.atomic_counters, &r.acceleration_structures, &r.push_constant_buffers, &r.separate_images, &r.separate_samplers};
+	};
+	auto la = lists(a), lb = lists(b);
+	for (size_t i = 0; i < la.size(); i++){
+		if (la[i]->size() != lb[i]->size()){
+			return false;
+		}
+		for (size_t j = 0; j < la[i]->size(); j++){
+			const auto& x = (*la[i])[j];
+			const auto& y = (*lb[i])[j];
+			if (x.id != y.id || x.type_id != y.type_id || x.base_type_id != y.base_type_id || x.name != y.name){
+				return false;
+			}
+		}
+	}
+	return a.compute_dim == b.compute_dim;
+}
+
+/**
+ @return the bytes a ReflectData occupies, including its heap storage
+ */
+size_t memoryUsage(const ReflectData& data){
+	size_t size = sizeof(data);
+	for (auto list : {&data.uniform_buffers, &data.storage_buffers, &data.stage_inputs, &data.stage_outputs, &data.subpass_inputs, &data.storage_images,
+		&data.sampled_images, &data.atomic_counters, &data.acceleration_structures, &data.push_constant_buffers, &data.separate_images, &data.separate_samplers}){
+		size += list->capacity() * sizeof(ReflectData::Resource);
+		for (const auto& resource : *list){
+			// names short enough for the small string buffer are not allocated
+			if (resource.name.capacity() > string().capacity()){
+				size += resource.name.capacity() + 1;
+			}
+		}
+	}
+	return size;
+}
+
+}
+
+int bench::RunReflectionBench(){
+	ShaderTranspiler transpiler;
+	int status = 0;
+	for (const auto& shape : shaderShapes){
+		// debug keeps names in the module, which the legacy implementation needs to order interface variables
+		Options opt;
+		opt.version = 16;
+		opt.mobile = false;
+		opt.debug = true;
+		const MemoryCompileTask task{GenerateShader(shape), string(shape.name) + ".vert", ShaderStage::Vertex};
+		const auto spirv = ToWords(transpiler.CompileTo(task, TargetAPI::Vulkan, opt).data.binaryData);
+
+		spirv_cross::Compiler comp(spirv);
+		const size_t iterations = shape.statements > 1000 ? 20 : 200;
+		const double legacy = MedianMicroseconds(iterations, [&]{
+			legacyReflectData(comp, spirv);
+		});
+		const double singlePass = MedianMicroseconds(iterations, [&]{
+			ReflectSPIRV(spirv);
+		});
+		const auto reflection = ReflectSPIRV(spirv);
+		const CompactReflectData compact(reflection);
+		const bool match = sameResources(legacyReflectData(comp, spirv), reflection) && sameResources(compact.ToReflectData(), reflection);
+		status |= !match;
+
+		cout << "reflection shader=" << shape.name << " words=" << spirv.size() << " legacy_us=" << legacy << " single_pass_us=" << singlePass
+			<< " speedup=" << legacy / singlePass << " bytes=" << memoryUsage(reflection) << " compact_bytes=" << compact.MemoryUsage()
+			<< " match=" << (match ? "yes" : "no") << endl;
+	}
+	return status;
+}
@@ -0,0 +1,158 @@
+#include "Bench.hpp"
+#include <ShaderTranspiler/ShaderTranspiler.hpp>
+#include <atomic>
+#include <iostream>
+#include <latch>
+#include <thread>
+
+using namespace std;
+using namespace shadert;
+
+namespace {
+
+struct Job{
+	FileCompileTask task;
+	TargetAPI api;
+	Options opt;
+};
+
+struct Run{
+	double seconds = 0;
+	size_t compiles = 0;
+	size_t failed = 0;
+	chrono::nanoseconds compileTime{};		// summed over every compile on every thread
+	chrono::nanoseconds lockWait{};
+	array<chrono::nanoseconds, size_t(CompileStage::Count)> stageTime{};
+};
+
+/**
+ Compile every job on each of the threads, all calling CompileTo on one ShaderTranspiler at the same time. Each thread
+ starts at a different job so that they do not move through the corpus in step.
+ */
+Run runThreads(ShaderTranspiler& transpiler, const vector<Job>& jobs, unsigned threadCount){
+	Run run;
+	mutex mtx;
+	latch ready(threadCount + 1);
+	atomic<bool> go = false;
+	vector<thread> threads;
+	for (unsigned t = 0; t < threadCount; t++){
+		threads.emplace_back([&, t]{
+			Run local;
+			ready.count_down();
+			while (!go.load()){
+				this_thread::yield();
+			}
+			for (size_t i = 0; i < jobs.size(); i++){
+				const auto& job = jobs[(i + t * jobs.size() / threadCount) % jobs.size()];
+				try{
+					const auto stats = *transpiler.CompileTo(job.task, job.api, job.opt).stats;
+					local.compileTime += stats.total;
+					local.lockWait += stats.lockWait;
+					for (size_t stage = 0; stage < local.stageTime.size(); stage++){
+						local.stageTime[stage] += stats.stageDurations[stage];
+					}
+					local.compiles++;
+				}
+				catch(exception&){
+					local.failed++;
+				}
+			}
+			lock_guard lock(mtx);
+			run.compiles += local.compiles;
+			run.failed += local.failed;
+			run.compileTime += local.compileTime;
+			run.lockWait += local.lockWait;
+			for (size_t stage = 0; stage < run.stageTime.size(); stage++){
+				run.stageTime[stage] += local.stageTime[stage];
+			}
+		});
+	}
+	ready.arrive_and_wait();
+	const auto start = chrono::steady_clock::now();
+	go = true;
+	for (auto& thread : threads){
+		thread.join();
+	}
+	run.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	return run;
+}
+
+double meanMicroseconds(chrono::nanoseconds total, size_t count){
+	return count == 0 ? 0 : chrono::duration<double, micro>(total).count() / count;
+}
+
+}
+
+int bench::RunScalingBench(){
+	struct Target{
+		TargetAPI api;
+		uint32_t version;
+	};
+	const Target targets[] = {
+		{TargetAPI::Vulkan, 16},
+		{TargetAPI::OpenGL, 410},
+		{TargetAPI::HLSL, 62},
+		{TargetAPI::Metal, 30},
+	};
+
+	const auto corpus = LoadCorpus();
+	if (corpus.empty()){
+		cerr << "scaling error=no shaders in " << ST_BENCH_CORPUS_DIR << endl;
+		return 1;
+	}
+	vector<Job> jobs;
+	for (const auto& target : targets){
+		Options opt;
+		opt.version = target.version;
+		opt.mobile = false;
+		opt.entryPoint = "main";
+		opt.collectStats = true;
+		for (const auto& shader : corpus){
+			jobs.push_back({FileCompileTask{shader.path, shader.stage}, target.api, opt});
+		}
+	}
+
+	// 1, 2, 4, ... up to the core count, and the core count itself. Two threads at least, to see contention on one core.
+	const unsigned cores = max(1u, thread::hardware_concurrency());
+	vector<unsigned> threadCounts;
+	for (unsigned count = 1; count < max(cores, 2u); count *= 2){
+		threadCounts.push_back(count);
+	}
+	threadCounts.push_back(max(cores, 2u));
+
+	// glslang builds its built-in symbol tables on first use while holding a global lock. Build them before measuring
+	// so that the runs show steady-state contention.
+	ShaderTranspiler::WarmUp({ShaderStage::Vertex, ShaderStage::Fragment, ShaderStage::Compute});
+	ShaderTranspiler transpiler;
+	runThreads(transpiler, jobs, 1);		// not measured, fills the include cache
+
+	int status = 0;
+	Run single;
+	for (const auto threadCount : threadCounts){
+		const auto run = runThreads(transpiler, jobs, threadCount);
+		if (threadCount == 1){
+			single = run;
+		}
+		const double throughput = run.compiles / run.seconds;
+		const double speedup = throughput / (single.compiles / single.seconds);
+		cout << "scaling threads=" << threadCount << " cores=" << cores << " compiles=" << run.compiles << " failed=" << run.failed
+			<< " seconds=" << run.seconds << " shaders_per_second=" << throughput << " speedup=" << speedup
+			<< " efficiency=" << speedup / min(threadCount, cores) << " mean_compile_us=" << meanMicroseconds(run.compileTime, run.compiles)
+			<< " lock_wait_us=" << chrono::duration<double, micro>(run.lockWait).count()
+			<< " lock_wait_fraction=" << chrono::duration<double>(run.lockWait).count() / chrono::duration<double>(run.compileTime).count() << endl;
+
+		// a stage that takes longer per compile as threads are added is contended. glslang's global lock is in parse.
+		for (size_t stage = 0; stage < run.stageTime.size(); stage++){
+			if (single.stageTime[stage].count() == 0){
+				continue;
+			}
+			const double mean = meanMicroseconds(run.stageTime[stage], run.compiles);
+			cout << "scaling_stage threads=" << threadCount << " stage=" << StageKey(CompileStage(stage)) << " mean_us=" << mean
+				<< " inflation=" << mean / meanMicroseconds(single.stageTime[stage], single.compiles) << endl;
+		}
+		if (run.failed > 0){
+			status = 1;
+		}
+	}
+	return status;
+}
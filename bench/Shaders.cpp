@@ -0,0 +1,40 @@
+#include "Bench.hpp"
+#include <sstream>
+
+std::string bench::GenerateShader(const ShaderShape& shape){
+	std::ostringstream src;
+	src << "#version 460\n";
+	for (int i = shape.inputs - 1; i >= 0; i--){
+		src << "layout(location = " << i << ") in vec4 in_" << i << ";\n";
+	}
+	for (int i = shape.outputs - 1; i >= 0; i--){
+		src << "layout(location = " << i << ") out vec4 out_" << i << ";\n";
+	}
+	for (int i = 0; i < shape.uniformBuffers; i++){
+		src << "layout(set = 0, binding = " << i << ") uniform UBO_" << i << " { vec4 v[16]; } ubo_" << i << ";\n";
+	}
+	for (int i = 0; i < shape.textures; i++){
+		src << "layout(set = 1, binding = " << i << ") uniform sampler2D tex_" << i << ";\n";
+	}
+	for (int i = 0; i < shape.storageBuffers; i++){
+		src << "layout(set = 2, binding = " << i << ") buffer SSBO_" << i << " { vec4 data[]; } ssbo_" << i << ";\n";
+	}
+	src << "void main(){\n\tvec4 acc = vec4(0);\n";
+	for (int i = 0; i < shape.inputs; i++){
+		src << "\tacc += in_" << i << ";\n";
+	}
+	for (int i = 0; i < shape.statements; i++){
+		src << "\tacc = sin(acc) * ubo_" << i % shape.uniformBuffers << ".v[" << i % 16 << "] + acc.wzyx;\n";
+	}
+	for (int i = 0; i < shape.textures; i++){
+		src << "\tacc += textureLod(tex_" << i << ", acc.xy, 0.0);\n";
+	}
+	for (int i = 0; i < shape.storageBuffers; i++){
+		src << "\tacc += ssbo_" << i << ".data[" << i << "];\n";
+	}
+	for (int i = 0; i < shape.outputs; i++){
+		src << "\tout_" << i << " = acc + vec4(" << i << ");\n";
+	}
+	src << "\tgl_Position = acc;\n}\n";
+	return src.str();
+}
@@ -0,0 +1,411 @@
+#version 460
+#include "include/lighting.glsl"
+#include "include/noise.glsl"
+
+// Uber material: PBR with clear coat, sheen, subsurface, parallax occlusion, detail maps, cascaded shadows,
+// screen space reflections, decals and height fog
+
+#define SHADOW_CASCADES 4
+#define PCF_SAMPLES 16
+#define POM_MAX_STEPS 32
+#define SSR_MAX_STEPS 48
+#define MAX_DECALS 16
+
+layout(set = 2, binding = 0) uniform sampler2D albedoMap;
+layout(set = 2, binding = 1) uniform sampler2D normalMap;
+layout(set = 2, binding = 2) uniform sampler2D ormMap;			// occlusion, roughness, metallic
+layout(set = 2, binding = 3) uniform sampler2D emissiveMap;
+layout(set = 2, binding = 4) uniform sampler2D heightMap;
+layout(set = 2, binding = 5) uniform sampler2D detailAlbedoMap;
+layout(set = 2, binding = 6) uniform sampler2D detailNormalMap;
+layout(set = 2, binding = 7) uniform sampler2D clearCoatMap;
+layout(set = 2, binding = 8) uniform sampler2D sheenMap;
+layout(set = 2, binding = 9) uniform sampler2D thicknessMap;
+layout(set = 2, binding = 10) uniform samplerCube irradianceMap;
+layout(set = 2, binding = 11) uniform samplerCube prefilteredMap;
+layout(set = 2, binding = 12) uniform sampler2D brdfLUT;
+layout(set = 2, binding = 13) uniform sampler2DArrayShadow shadowCascades;
+layout(set = 2, binding = 14) uniform sampler2D sceneColor;
+layout(set = 2, binding = 15) uniform sampler2D sceneDepth;
+layout(set = 2, binding = 16) uniform sampler2DArray decalAtlas;
+
+layout(std140, set = 2, binding = 17) uniform MaterialData {
+	vec4 baseColorFactor;
+	vec4 emissiveFactor;
+	vec4 sheenColor;
+	vec4 subsurfaceColor;
+	vec4 detailScaleBias;
+	float metallicFactor;
+	float roughnessFactor;
+	float normalScale;
+	float alphaCutoff;
+	float clearCoat;
+	float clearCoatRoughness;
+	float sheenRoughness;
+	float subsurfaceScale;
+	float parallaxScale;
+	float detailBlend;
+	float ior;
+	uint features;
+} material;
+
+layout(std140, set = 2, binding = 18) uniform ShadowData {
+	mat4 cascadeViewProjection[SHADOW_CASCADES];
+	vec4 cascadeSplits;
+	vec4 shadowParams;		// x bias, y normal bias, z filter radius, w fade distance
+} shadows;
+
+struct Decal {
+	mat4 worldToDecal;
+	vec4 color;
+	vec4 params;			// x atlas layer, y normal strength, z roughness, w blend
+};
+
+layout(std140, set = 2, binding = 19) uniform DecalData {
+	uint decalCount;
+	Decal decals[MAX_DECALS];
+} decalData;
+
+layout(std140, set = 2, binding = 20) uniform FogData {
+	vec4 color;
+	vec4 params;			// x density, y height falloff, z base height, w max opacity
+	vec4 inscattering;		// rgb color, w exponent
+} fog;
+
+const uint FEATURE_CLEARCOAT = 1u;
+const uint FEATURE_SHEEN = 2u;
+const uint FEATURE_SUBSURFACE = 4u;
+const uint FEATURE_PARALLAX = 8u;
+const uint FEATURE_DETAIL = 16u;
+const uint FEATURE_SSR = 32u;
+const uint FEATURE_DECALS = 64u;
+const uint FEATURE_FOG = 128u;
+const uint FEATURE_DITHER = 256u;
+
+layout(location = 0) in vec3 inWorldPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec4 inTangent;
+layout(location = 3) in vec2 inUV0;
+layout(location = 4) in vec2 inUV1;
+layout(location = 5) in vec4 inColor;
+layout(location = 6) in vec4 inCurrentClip;
+layout(location = 7) in vec4 inPreviousClip;
+layout(location = 8) in float inWindAmount;
+layout(location = 9) in float inViewDepth;
+
+layout(location = 0) out vec4 outColor;
+layout(location = 1) out vec2 outNormal;
+layout(location = 2) out vec2 outVelocity;
+layout(location = 3) out vec4 outMaterial;
+
+const vec2 poissonDisk[PCF_SAMPLES] = vec2[](
+	vec2(-0.94201624, -0.39906216), vec2(0.94558609, -0.76890725),
+	vec2(-0.09418410, -0.92938870), vec2(0.34495938, 0.29387760),
+	vec2(-0.91588581, 0.45771432), vec2(-0.81544232, -0.87912464),
+	vec2(-0.38277543, 0.27676845), vec2(0.97484398, 0.75648379),
+	vec2(0.44323325, -0.97511554), vec2(0.53742981, -0.47373420),
+	vec2(-0.26496911, -0.41893023), vec2(0.79197514, 0.19090188),
+	vec2(-0.24188840, 0.99706507), vec2(-0.81409955, 0.91437590),
+	vec2(0.19984126, 0.78641367), vec2(0.14383161, -0.14100790)
+);
+
+bool hasFeature(uint feature) {
+	return (material.features & feature) != 0u;
+}
+
+mat3 tangentFrame() {
+	vec3 N = normalize(inNormal);
+	vec3 T = normalize(inTangent.xyz - N * dot(N, inTangent.xyz));
+	vec3 B = cross(N, T) * inTangent.w;
+	return mat3(T, B, N);
+}
+
+vec2 parallaxOcclusion(vec2 uv, vec3 viewTangent) {
+	float steps = mix(float(POM_MAX_STEPS), 8.0, abs(viewTangent.z));
+	float layerDepth = 1.0 / steps;
+	vec2 delta = viewTangent.xy / max(viewTangent.z, 0.1) * material.parallaxScale / steps;
+
+	vec2 currentUV = uv;
+	float currentDepth = 0.0;
+	float sampledDepth = 1.0 - texture(heightMap, currentUV).r;
+	for (int i = 0; i < POM_MAX_STEPS; i++) {
+		if (currentDepth >= sampledDepth || float(i) >= steps) {
+			break;
+		}
+		currentUV -= delta;
+		sampledDepth = 1.0 - texture(heightMap, currentUV).r;
+		currentDepth += layerDepth;
+	}
+
+	// interpolate between the last two layers
+	vec2 previousUV = currentUV + delta;
+	float after = sampledDepth - currentDepth;
+	float before = (1.0 - texture(heightMap, previousUV).r) - currentDepth + layerDepth;
+	float weight = after / (after - before);
+	return mix(currentUV, previousUV, weight);
+}
+
+vec3 blendNormals(vec3 base, vec3 detail) {
+	// reoriented normal mapping
+	vec3 t = base + vec3(0.0, 0.0, 1.0);
+	vec3 u = detail * vec3(-1.0, -1.0, 1.0);
+	return normalize(t * dot(t, u) - u * t.z);
+}
+
+int selectCascade(float viewDepth) {
+	for (int i = 0; i < SHADOW_CASCADES - 1; i++) {
+		if (viewDepth < shadows.cascadeSplits[i]) {
+			return i;
+		}
+	}
+	return SHADOW_CASCADES - 1;
+}
+
+float sampleCascade(int cascade, vec3 worldPosition, vec3 normal) {
+	vec3 offsetPosition = worldPosition + normal * shadows.shadowParams.y * float(cascade + 1);
+	vec4 shadowClip = shadows.cascadeViewProjection[cascade] * vec4(offsetPosition, 1.0);
+	vec3 shadowCoord = shadowClip.xyz / shadowClip.w;
+	shadowCoord.xy = shadowCoord.xy * 0.5 + 0.5;
+	if (any(lessThan(shadowCoord.xy, vec2(0.0))) || any(greaterThan(shadowCoord.xy, vec2(1.0)))) {
+		return 1.0;
+	}
+
+	float rotation = hash12(gl_FragCoord.xy) * 2.0 * PI;
+	mat2 rotate = mat2(cos(rotation), sin(rotation), -sin(rotation), cos(rotation));
+	vec2 texelSize = 1.0 / vec2(textureSize(shadowCascades, 0).xy);
+	float radius = shadows.shadowParams.z / float(cascade + 1);
+
+	float lit = 0.0;
+	for (int i = 0; i < PCF_SAMPLES; i++) {
+		vec2 offset = rotate * poissonDisk[i] * texelSize * radius;
+		lit += texture(shadowCascades, vec4(shadowCoord.xy + offset, float(cascade), shadowCoord.z - shadows.shadowParams.x));
+	}
+	return lit / float(PCF_SAMPLES);
+}
+
+float sunShadow(vec3 worldPosition, vec3 normal, float viewDepth) {
+	int cascade = selectCascade(viewDepth);
+	float shadow = sampleCascade(cascade, worldPosition, normal);
+
+	// blend into the next cascade near the split
+	if (cascade < SHADOW_CASCADES - 1) {
+		float split = shadows.cascadeSplits[cascade];
+		float blend = saturate((viewDepth - split * 0.9) / (split * 0.1));
+		if (blend > 0.0) {
+			shadow = mix(shadow, sampleCascade(cascade + 1, worldPosition, normal), blend);
+		}
+	}
+
+	float fade = saturate((shadows.shadowParams.w - viewDepth) / (shadows.shadowParams.w * 0.1));
+	return mix(1.0, shadow, fade);
+}
+
+vec3 clearCoatLayer(Surface surface, vec3 clearCoatNormal, vec3 L, vec3 radiance, float strength, float roughness) {
+	vec3 H = normalize(surface.view + L);
+	float NdotL = max(dot(clearCoatNormal, L), 0.0);
+	float NdotV = max(dot(clearCoatNormal, surface.view), EPSILON);
+	float NdotH = max(dot(clearCoatNormal, H), 0.0);
+	float VdotH = max(dot(surface.view, H), 0.0);
+
+	float D = distributionGGX(NdotH, roughness);
+	float V = 0.25 / max(VdotH * VdotH, EPSILON);
+	float F = fresnelSchlick(VdotH, vec3(0.04)).r * strength;
+	return vec3(D * V * F) * radiance * NdotL;
+}
+
+float charlieDistribution(float NdotH, float roughness) {
+	float invAlpha = 1.0 / max(roughness * roughness, EPSILON);
+	float cos2h = NdotH * NdotH;
+	float sin2h = max(1.0 - cos2h, 0.0078125);
+	return (2.0 + invAlpha) * pow(sin2h, invAlpha * 0.5) / (2.0 * PI);
+}
+
+vec3 sheenLayer(Surface surface, vec3 L, vec3 radiance, vec3 sheenColor, float roughness) {
+	vec3 H = normalize(surface.view + L);
+	float NdotL = max(dot(surface.normal, L), 0.0);
+	float NdotV = max(dot(surface.normal, surface.view), EPSILON);
+	float NdotH = max(dot(surface.normal, H), 0.0);
+	float D = charlieDistribution(NdotH, roughness);
+	float V = 1.0 / (4.0 * (NdotL + NdotV - NdotL * NdotV) + EPSILON);
+	return sheenColor * D * V * radiance * NdotL;
+}
+
+vec3 subsurfaceTransmission(Surface surface, vec3 L, vec3 radiance, vec3 color, float thickness) {
+	vec3 scatterDirection = L + surface.normal * 0.3;
+	float VdotL = pow(saturate(dot(surface.view, -scatterDirection)), 4.0) * material.subsurfaceScale;
+	float transmission = exp(-thickness * 4.0);
+	return color * radiance * VdotL * transmission;
+}
+
+vec3 ambientLighting(Surface surface, vec3 F0) {
+	float NdotV = max(dot(surface.normal, surface.view), EPSILON);
+	vec3 F = fresnelSchlickRoughness(NdotV, F0, surface.roughness);
+	vec3 kD = (1.0 - F) * (1.0 - surface.metallic);
+	vec3 irradiance = texture(irradianceMap, surface.normal).rgb;
+	vec3 R = reflect(-surface.view, surface.normal);
+	vec3 prefiltered = textureLod(prefilteredMap, R, surface.roughness * 6.0).rgb;
+	vec2 brdf = texture(brdfLUT, vec2(NdotV, surface.roughness)).rg;
+	return (kD * irradiance * surface.albedo + prefiltered * (F * brdf.x + brdf.y)) * surface.occlusion;
+}
+
+vec4 screenSpaceReflection(Surface surface) {
+	vec3 R = reflect(-surface.view, surface.normal);
+	vec3 position = surface.position;
+	float stepSize = 0.15;
+	for (int i = 0; i < SSR_MAX_STEPS; i++) {
+		position += R * stepSize;
+		vec4 clip = frame.viewProjection * vec4(position, 1.0);
+		vec3 ndc = clip.xyz / clip.w;
+		vec2 uv = ndc.xy * 0.5 + 0.5;
+		if (any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0)))) {
+			break;
+		}
+		float sceneZ = textureLod(sceneDepth, uv, 0.0).r;
+		float difference = ndc.z - sceneZ;
+		if (difference > 0.0 && difference < 0.002 * float(i + 1)) {
+			float edgeFade = 1.0 - pow(max(abs(ndc.x), abs(ndc.y)), 8.0);
+			float confidence = edgeFade * (1.0 - float(i) / float(SSR_MAX_STEPS)) * (1.0 - surface.roughness);
+			return vec4(textureLod(sceneColor, uv, surface.roughness * 4.0).rgb, saturate(confidence));
+		}
+		stepSize *= 1.08;
+	}
+	return vec4(0.0);
+}
+
+void applyDecals(inout Surface surface, inout vec3 albedo) {
+	uint count = min(decalData.decalCount, uint(MAX_DECALS));
+	for (uint i = 0; i < count; i++) {
+		Decal decal = decalData.decals[i];
+		vec4 decalPosition = decal.worldToDecal * vec4(surface.position, 1.0);
+		if (any(greaterThan(abs(decalPosition.xyz), vec3(0.5)))) {
+			continue;
+		}
+		vec2 uv = decalPosition.xz + 0.5;
+		vec4 decalColor = texture(decalAtlas, vec3(uv, decal.params.x)) * decal.color;
+		float blend = decalColor.a * decal.params.w * saturate(1.0 - abs(decalPosition.y) * 2.0);
+		albedo = mix(albedo, decalColor.rgb, blend);
+		surface.roughness = mix(surface.roughness, decal.params.z, blend);
+	}
+}
+
+vec3 applyFog(vec3 color, vec3 worldPosition) {
+	vec3 toCamera = worldPosition - frame.cameraPosition.xyz;
+	float distance = length(toCamera);
+	float heightFalloff = fog.params.y;
+	float baseHeight = fog.params.z;
+	float startHeight = frame.cameraPosition.y - baseHeight;
+	float fogAmount = fog.params.x * exp(-heightFalloff * startHeight);
+	if (abs(toCamera.y) > EPSILON) {
+		fogAmount *= (1.0 - exp(-heightFalloff * toCamera.y)) / (heightFalloff * toCamera.y);
+	}
+	float opacity = min(1.0 - exp(-fogAmount * distance), fog.params.w);
+
+	// light scattering towards the sun
+	float sunAmount = pow(saturate(dot(normalize(toCamera), -frame.sunDirection.xyz)), fog.inscattering.w);
+	vec3 fogColor = mix(fog.color.rgb, fog.inscattering.rgb, sunAmount);
+
+	// break up the fog with noise
+	float noise = fbm(worldPosition * 0.05 + vec3(frame.time * 0.02, 0.0, 0.0), 3) * 0.5 + 0.5;
+	return mix(color, fogColor, opacity * mix(0.7, 1.0, noise));
+}
+
+void main() {
+	mat3 TBN = tangentFrame();
+	vec3 view = normalize(frame.cameraPosition.xyz - inWorldPosition);
+
+	vec2 uv = inUV0;
+	if (hasFeature(FEATURE_PARALLAX)) {
+		vec3 viewTangent = normalize(transpose(TBN) * view);
+		uv = parallaxOcclusion(uv, viewTangent);
+	}
+
+	vec4 baseColor = texture(albedoMap, uv) * material.baseColorFactor * inColor;
+	if (hasFeature(FEATURE_DITHER)) {
+		float threshold = hash12(gl_FragCoord.xy + vec2(frame.time));
+		if (baseColor.a < threshold) {
+			discard;
+		}
+	}
+	else if (baseColor.a < material.alphaCutoff) {
+		discard;
+	}
+
+	vec3 tangentNormal = texture(normalMap, uv).xyz * 2.0 - 1.0;
+	tangentNormal.xy *= material.normalScale;
+	vec3 albedo = baseColor.rgb;
+	if (hasFeature(FEATURE_DETAIL)) {
+		vec2 detailUV = uv * material.detailScaleBias.xy + material.detailScaleBias.zw;
+		vec3 detailAlbedo = texture(detailAlbedoMap, detailUV).rgb * 2.0;
+		vec3 detailNormal = texture(detailNormalMap, detailUV).xyz * 2.0 - 1.0;
+		albedo = mix(albedo, albedo * detailAlbedo, material.detailBlend);
+		tangentNormal = blendNormals(normalize(tangentNormal), normalize(detailNormal));
+	}
+
+	vec3 orm = texture(ormMap, uv).rgb;
+	Surface surface;
+	surface.position = inWorldPosition;
+	surface.normal = normalize(TBN * tangentNormal);
+	surface.view = view;
+	surface.metallic = orm.b * material.metallicFactor;
+	surface.roughness = clamp(orm.g * material.roughnessFactor, 0.04, 1.0);
+	surface.occlusion = orm.r;
+	surface.emissive = texture(emissiveMap, uv).rgb * material.emissiveFactor.rgb;
+
+	if (hasFeature(FEATURE_DECALS)) {
+		applyDecals(surface, albedo);
+	}
+	surface.albedo = albedo;
+
+	// wind makes foliage slightly rougher
+	surface.roughness = saturate(surface.roughness + inWindAmount * 0.05);
+
+	vec3 F0 = mix(vec3(pow((material.ior - 1.0) / (material.ior + 1.0), 2.0)), surface.albedo, surface.metallic);
+	vec3 sunL = normalize(-frame.sunDirection.xyz);
+	vec3 sunRadiance = frame.sunColor.rgb * frame.sunColor.a * sunShadow(inWorldPosition, surface.normal, inViewDepth);
+
+	vec3 color = evaluateBRDF(surface, sunL, sunRadiance);
+	uint count = min(lightData.lightCount, uint(MAX_LIGHTS));
+	for (uint i = 0; i < count; i++) {
+		color += evaluateLight(surface, lightData.lights[i]);
+	}
+
+	if (hasFeature(FEATURE_CLEARCOAT)) {
+		vec2 clearCoatSample = texture(clearCoatMap, uv).rg;
+		float strength = material.clearCoat * clearCoatSample.r;
+		float roughness = clamp(material.clearCoatRoughness * clearCoatSample.g, 0.04, 1.0);
+		vec3 clearCoatNormal = normalize(inNormal);
+		float coatFresnel = fresnelSchlick(max(dot(clearCoatNormal, view), 0.0), vec3(0.04)).r * strength;
+		color = color * (1.0 - coatFresnel) + clearCoatLayer(surface, clearCoatNormal, sunL, sunRadiance, strength, roughness);
+	}
+
+	if (hasFeature(FEATURE_SHEEN)) {
+		vec3 sheenColor = material.sheenColor.rgb * texture(sheenMap, uv).rgb;
+		color += sheenLayer(surface, sunL, sunRadiance, sheenColor, material.sheenRoughness);
+	}
+
+	if (hasFeature(FEATURE_SUBSURFACE)) {
+		float thickness = texture(thicknessMap, uv).r;
+		color += subsurfaceTransmission(surface, sunL, sunRadiance, material.subsurfaceColor.rgb * surface.albedo, thickness);
+	}
+
+	vec3 ambient = ambientLighting(surface, F0);
+	if (hasFeature(FEATURE_SSR)) {
+		vec4 reflection = screenSpaceReflection(surface);
+		vec3 F = fresnelSchlickRoughness(max(dot(surface.normal, view), EPSILON), F0, surface.roughness);
+		ambient = mix(ambient, reflection.rgb * F * surface.occlusion, reflection.a);
+	}
+	color += ambient + surface.emissive;
+
+	if (hasFeature(FEATURE_FOG)) {
+		color = applyFog(color, inWorldPosition);
+	}
+
+	color = tonemapACES(color * frame.exposure);
+	outColor = vec4(linearToSrgb(color), baseColor.a);
+	outNormal = encodeNormal(surface.normal);
+
+	vec2 current = inCurrentClip.xy / inCurrentClip.w;
+	vec2 previous = inPreviousClip.xy / inPreviousClip.w;
+	outVelocity = (current - previous) * 0.5;
+	outMaterial = vec4(surface.metallic, surface.roughness, surface.occlusion, float(material.features & 0xffu) / 255.0);
+}
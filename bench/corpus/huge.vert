@@ -0,0 +1,236 @@
+#version 460
+#include "include/common.glsl"
+#include "include/noise.glsl"
+#include "include/skinning.glsl"
+
+// Vertex shader for animated vegetation and characters: skinning, morph targets, wind and terrain conforming
+
+#define MAX_MORPH_TARGETS 8
+#define WIND_OCTAVES 4
+
+layout(push_constant) uniform Constants {
+	mat4 model;
+	mat4 previousModel;
+	uint boneOffset;
+	uint morphOffset;
+	uint morphCount;
+	uint flags;
+} constants;
+
+const uint FLAG_SKINNED = 1u;
+const uint FLAG_MORPHED = 2u;
+const uint FLAG_WIND = 4u;
+const uint FLAG_TERRAIN = 8u;
+const uint FLAG_BILLBOARD = 16u;
+
+struct MorphDelta {
+	vec4 position;
+	vec4 normal;
+	vec4 tangent;
+};
+
+layout(std430, set = 1, binding = 1) readonly buffer MorphBuffer {
+	MorphDelta deltas[];
+} morphData;
+
+layout(std430, set = 1, binding = 2) readonly buffer MorphWeights {
+	float weights[];
+} morphWeights;
+
+layout(std430, set = 1, binding = 3) readonly buffer PreviousBones {
+	mat4 bones[];
+} previousBoneData;
+
+layout(std140, set = 1, binding = 4) uniform WindData {
+	vec4 direction;		// xyz direction, w strength
+	vec4 gust;			// x frequency, y amplitude, z turbulence, w scale
+	vec4 bend;			// x stiffness, y height falloff, z flutter, w flutter frequency
+} wind;
+
+layout(set = 1, binding = 5) uniform sampler2D heightMap;
+layout(set = 1, binding = 6) uniform sampler2D terrainNormalMap;
+
+layout(std140, set = 1, binding = 7) uniform TerrainData {
+	vec4 extent;		// xy origin, zw size
+	float heightScale;
+	float heightOffset;
+} terrain;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec4 inTangent;
+layout(location = 3) in vec2 inUV0;
+layout(location = 4) in vec2 inUV1;
+layout(location = 5) in uvec4 inJoints;
+layout(location = 6) in vec4 inWeights;
+layout(location = 7) in vec4 inColor;
+layout(location = 8) in vec4 inInstanceData;	// xyz offset, w scale
+
+layout(location = 0) out vec3 outWorldPosition;
+layout(location = 1) out vec3 outNormal;
+layout(location = 2) out vec4 outTangent;
+layout(location = 3) out vec2 outUV0;
+layout(location = 4) out vec2 outUV1;
+layout(location = 5) out vec4 outColor;
+layout(location = 6) out vec4 outCurrentClip;
+layout(location = 7) out vec4 outPreviousClip;
+layout(location = 8) out float outWindAmount;
+layout(location = 9) out float outViewDepth;
+
+struct VertexState {
+	vec3 position;
+	vec3 normal;
+	vec3 tangent;
+};
+
+VertexState applyMorphTargets(VertexState state) {
+	uint count = min(constants.morphCount, uint(MAX_MORPH_TARGETS));
+	for (uint i = 0; i < count; i++) {
+		float weight = morphWeights.weights[constants.morphOffset + i];
+		if (abs(weight) < EPSILON) {
+			continue;
+		}
+		MorphDelta delta = morphData.deltas[(constants.morphOffset + i) * uint(gl_VertexIndex + 1)];
+		state.position += delta.position.xyz * weight;
+		state.normal += delta.normal.xyz * weight;
+		state.tangent += delta.tangent.xyz * weight;
+	}
+	state.normal = normalize(state.normal);
+	state.tangent = normalize(state.tangent);
+	return state;
+}
+
+mat4 previousSkinMatrix(uvec4 joints, vec4 weights) {
+	return previousBoneData.bones[joints.x] * weights.x
+		+ previousBoneData.bones[joints.y] * weights.y
+		+ previousBoneData.bones[joints.z] * weights.z
+		+ previousBoneData.bones[joints.w] * weights.w;
+}
+
+vec3 windDisplacement(vec3 worldPosition, vec3 objectPosition, float height, float time) {
+	vec3 direction = normalize(wind.direction.xyz + vec3(EPSILON));
+	float strength = wind.direction.w;
+
+	// large scale gusts travelling across the world
+	vec3 samplePosition = worldPosition * wind.gust.w + direction * time * wind.gust.x;
+	float gust = fbm(samplePosition, WIND_OCTAVES) * wind.gust.y;
+
+	// turbulence varies the direction
+	float turbulence = simplexNoise(samplePosition * 3.7 + vec3(0.0, time, 0.0)) * wind.gust.z;
+	vec3 turbulentDirection = normalize(direction + vec3(turbulence, 0.0, -turbulence));
+
+	// bend more towards the top, less for stiff plants
+	float bendFactor = pow(saturate(height * wind.bend.y), 1.5) / max(wind.bend.x, EPSILON);
+	vec3 bend = turbulentDirection * (strength + gust) * bendFactor;
+
+	// leaves flutter at a higher frequency
+	float phase = dot(objectPosition, vec3(1.0)) + hash12(objectPosition.xz) * 6.2831;
+	float flutter = sin(time * wind.bend.w + phase) * wind.bend.z * height;
+	vec3 flutterOffset = vec3(0.0, flutter, 0.0) + cross(turbulentDirection, vec3(0.0, 1.0, 0.0)) * flutter * 0.5;
+
+	// keep the length of the stem roughly constant
+	vec3 displaced = bend + flutterOffset;
+	displaced.y -= length(displaced.xz) * 0.3;
+	return displaced;
+}
+
+vec2 terrainUV(vec3 worldPosition) {
+	return (worldPosition.xz - terrain.extent.xy) / terrain.extent.zw;
+}
+
+float terrainHeight(vec3 worldPosition) {
+	return textureLod(heightMap, terrainUV(worldPosition), 0.0).r * terrain.heightScale + terrain.heightOffset;
+}
+
+vec3 terrainNormal(vec3 worldPosition) {
+	return normalize(textureLod(terrainNormalMap, terrainUV(worldPosition), 0.0).xyz * 2.0 - 1.0);
+}
+
+mat3 alignToNormal(vec3 normal) {
+	vec3 up = abs(normal.y) < 0.999 ? vec3(0.0, 1.0, 0.0) : vec3(1.0, 0.0, 0.0);
+	vec3 tangent = normalize(cross(up, normal));
+	vec3 bitangent = cross(normal, tangent);
+	return mat3(tangent, normal, bitangent);
+}
+
+vec3 billboard(vec3 localPosition, vec3 center) {
+	vec3 right = vec3(frame.view[0][0], frame.view[1][0], frame.view[2][0]);
+	vec3 up = vec3(0.0, 1.0, 0.0);
+	return center + right * localPosition.x + up * localPosition.y;
+}
+
+void main() {
+	float time = frame.time;
+	VertexState state;
+	state.position = inPosition;
+	state.normal = inNormal;
+	state.tangent = inTangent.xyz;
+
+	if ((constants.flags & FLAG_MORPHED) != 0u) {
+		state = applyMorphTargets(state);
+	}
+
+	mat4 world = constants.model;
+	mat4 previousWorld = constants.previousModel;
+	if ((constants.flags & FLAG_SKINNED) != 0u) {
+		uvec4 joints = inJoints + uvec4(constants.boneOffset);
+		world = world * skinMatrix(joints, inWeights);
+		previousWorld = previousWorld * previousSkinMatrix(joints, inWeights);
+	}
+
+	// instances are offset and scaled in world space
+	vec3 instanceOffset = inInstanceData.xyz;
+	float instanceScale = max(inInstanceData.w, EPSILON);
+
+	vec3 objectPosition = (world * vec4(0.0, 0.0, 0.0, 1.0)).xyz + instanceOffset;
+	vec4 worldPosition = world * vec4(state.position * instanceScale, 1.0);
+	worldPosition.xyz += instanceOffset;
+	vec4 previousWorldPosition = previousWorld * vec4(state.position * instanceScale, 1.0);
+	previousWorldPosition.xyz += instanceOffset;
+
+	mat3 normalMatrix = transpose(inverse(mat3(world)));
+	vec3 normal = normalize(normalMatrix * state.normal);
+	vec3 tangent = normalize(normalMatrix * state.tangent);
+
+	if ((constants.flags & FLAG_TERRAIN) != 0u) {
+		float groundHeight = terrainHeight(objectPosition);
+		vec3 groundNormal = terrainNormal(objectPosition);
+		mat3 align = alignToNormal(groundNormal);
+		vec3 local = worldPosition.xyz - objectPosition;
+		worldPosition.xyz = objectPosition + align * local;
+		worldPosition.y += groundHeight - objectPosition.y;
+		previousWorldPosition.y += groundHeight - objectPosition.y;
+		normal = normalize(align * normal);
+		tangent = normalize(align * tangent);
+	}
+
+	float windAmount = 0.0;
+	if ((constants.flags & FLAG_WIND) != 0u) {
+		float height = max(state.position.y * instanceScale, 0.0);
+		vec3 displacement = windDisplacement(worldPosition.xyz, objectPosition, height, time);
+		vec3 previousDisplacement = windDisplacement(previousWorldPosition.xyz, objectPosition, height, time - 1.0 / 60.0);
+		worldPosition.xyz += displacement;
+		previousWorldPosition.xyz += previousDisplacement;
+		windAmount = length(displacement);
+		normal = normalize(normal + displacement * 0.25);
+	}
+
+	if ((constants.flags & FLAG_BILLBOARD) != 0u) {
+		worldPosition.xyz = billboard(state.position * instanceScale, objectPosition);
+		previousWorldPosition.xyz = worldPosition.xyz;
+		normal = normalize(frame.cameraPosition.xyz - objectPosition);
+	}
+
+	outWorldPosition = worldPosition.xyz;
+	outNormal = normal;
+	outTangent = vec4(tangent, inTangent.w);
+	outUV0 = inUV0;
+	outUV1 = inUV1;
+	outColor = vec4(srgbToLinear(inColor.rgb), inColor.a);
+	outWindAmount = windAmount;
+	outViewDepth = -(frame.view * worldPosition).z;
+
+	gl_Position = frame.viewProjection * worldPosition;
+	outCurrentClip = gl_Position;
+	outPreviousClip = frame.viewProjection * previousWorldPosition;
+}
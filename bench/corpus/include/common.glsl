@@ -0,0 +1,61 @@
+#ifndef COMMON_GLSL
+#define COMMON_GLSL
+
+const float PI = 3.14159265359;
+const float INV_PI = 0.31830988618;
+const float EPSILON = 1e-5;
+
+layout(std140, set = 0, binding = 0) uniform FrameData {
+	mat4 view;
+	mat4 projection;
+	mat4 viewProjection;
+	mat4 inverseViewProjection;
+	vec4 cameraPosition;
+	vec4 sunDirection;
+	vec4 sunColor;
+	vec2 viewportSize;
+	float time;
+	float exposure;
+} frame;
+
+float saturate(float x) {
+	return clamp(x, 0.0, 1.0);
+}
+
+vec3 saturate(vec3 x) {
+	return clamp(x, vec3(0.0), vec3(1.0));
+}
+
+float luminance(vec3 color) {
+	return dot(color, vec3(0.2126, 0.7152, 0.0722));
+}
+
+vec3 decodeNormal(vec2 encoded) {
+	vec2 f = encoded * 2.0 - 1.0;
+	vec3 n = vec3(f, 1.0 - abs(f.x) - abs(f.y));
+	float t = saturate(-n.z);
+	n.xy += mix(vec2(t), vec2(-t), step(vec2(0.0), n.xy));
+	return normalize(n);
+}
+
+vec2 encodeNormal(vec3 n) {
+	n /= abs(n.x) + abs(n.y) + abs(n.z);
+	vec2 encoded = n.z >= 0.0 ? n.xy : (1.0 - abs(n.yx)) * mix(vec2(-1.0), vec2(1.0), step(vec2(0.0), n.xy));
+	return encoded * 0.5 + 0.5;
+}
+
+vec3 reconstructPosition(vec2 uv, float depth) {
+	vec4 clip = vec4(uv * 2.0 - 1.0, depth, 1.0);
+	vec4 world = frame.inverseViewProjection * clip;
+	return world.xyz / world.w;
+}
+
+vec3 srgbToLinear(vec3 color) {
+	return mix(color / 12.92, pow((color + 0.055) / 1.055, vec3(2.4)), step(vec3(0.04045), color));
+}
+
+vec3 linearToSrgb(vec3 color) {
+	return mix(color * 12.92, 1.055 * pow(color, vec3(1.0 / 2.4)) - 0.055, step(vec3(0.0031308), color));
+}
+
+#endif
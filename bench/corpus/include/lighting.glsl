@@ -0,0 +1,121 @@
+#ifndef LIGHTING_GLSL
+#define LIGHTING_GLSL
+#include "common.glsl"
+
+#define MAX_LIGHTS 64
+
+struct Light {
+	vec4 positionRadius;	// xyz position, w radius. w = 0 for directional lights.
+	vec4 colorIntensity;
+	vec4 direction;			// xyz direction, w cosine of the outer cone angle for spot lights
+	vec4 params;			// x cosine of the inner cone angle, y shadow index, z type
+};
+
+layout(std430, set = 0, binding = 1) readonly buffer LightBuffer {
+	uint lightCount;
+	Light lights[];
+} lightData;
+
+struct Surface {
+	vec3 position;
+	vec3 normal;
+	vec3 view;
+	vec3 albedo;
+	float metallic;
+	float roughness;
+	float occlusion;
+	vec3 emissive;
+};
+
+float distributionGGX(float NdotH, float roughness) {
+	float a = roughness * roughness;
+	float a2 = a * a;
+	float d = NdotH * NdotH * (a2 - 1.0) + 1.0;
+	return a2 / max(PI * d * d, EPSILON);
+}
+
+float geometrySchlickGGX(float NdotV, float roughness) {
+	float r = roughness + 1.0;
+	float k = (r * r) / 8.0;
+	return NdotV / (NdotV * (1.0 - k) + k);
+}
+
+float geometrySmith(float NdotV, float NdotL, float roughness) {
+	return geometrySchlickGGX(NdotV, roughness) * geometrySchlickGGX(NdotL, roughness);
+}
+
+vec3 fresnelSchlick(float cosTheta, vec3 F0) {
+	return F0 + (1.0 - F0) * pow(1.0 - cosTheta, 5.0);
+}
+
+vec3 fresnelSchlickRoughness(float cosTheta, vec3 F0, float roughness) {
+	return F0 + (max(vec3(1.0 - roughness), F0) - F0) * pow(1.0 - cosTheta, 5.0);
+}
+
+float attenuation(float distance, float radius) {
+	float ratio = distance / max(radius, EPSILON);
+	float falloff = saturate(1.0 - ratio * ratio * ratio * ratio);
+	return falloff * falloff / (distance * distance + 1.0);
+}
+
+float spotFactor(Light light, vec3 L) {
+	float cosOuter = light.direction.w;
+	float cosInner = light.params.x;
+	float cosAngle = dot(-L, normalize(light.direction.xyz));
+	return saturate((cosAngle - cosOuter) / max(cosInner - cosOuter, EPSILON));
+}
+
+vec3 evaluateBRDF(Surface surface, vec3 L, vec3 radiance) {
+	vec3 H = normalize(surface.view + L);
+	float NdotV = max(dot(surface.normal, surface.view), EPSILON);
+	float NdotL = max(dot(surface.normal, L), 0.0);
+	float NdotH = max(dot(surface.normal, H), 0.0);
+	float HdotV = max(dot(H, surface.view), 0.0);
+
+	vec3 F0 = mix(vec3(0.04), surface.albedo, surface.metallic);
+	vec3 F = fresnelSchlick(HdotV, F0);
+	float D = distributionGGX(NdotH, surface.roughness);
+	float G = geometrySmith(NdotV, NdotL, surface.roughness);
+
+	vec3 specular = D * G * F / max(4.0 * NdotV * NdotL, EPSILON);
+	vec3 kD = (vec3(1.0) - F) * (1.0 - surface.metallic);
+	return (kD * surface.albedo * INV_PI + specular) * radiance * NdotL;
+}
+
+vec3 evaluateLight(Surface surface, Light light) {
+	vec3 L;
+	float falloff = 1.0;
+	if (light.positionRadius.w == 0.0) {
+		L = normalize(-light.direction.xyz);
+	}
+	else {
+		vec3 toLight = light.positionRadius.xyz - surface.position;
+		float distance = length(toLight);
+		L = toLight / max(distance, EPSILON);
+		falloff = attenuation(distance, light.positionRadius.w);
+		if (light.params.z > 1.5) {
+			falloff *= spotFactor(light, L);
+		}
+	}
+	return evaluateBRDF(surface, L, light.colorIntensity.rgb * light.colorIntensity.a * falloff);
+}
+
+vec3 evaluateLights(Surface surface) {
+	vec3 color = evaluateBRDF(surface, normalize(-frame.sunDirection.xyz), frame.sunColor.rgb * frame.sunColor.a);
+	uint count = min(lightData.lightCount, uint(MAX_LIGHTS));
+	for (uint i = 0; i < count; i++) {
+		color += evaluateLight(surface, lightData.lights[i]);
+	}
+	return color;
+}
+
+vec3 tonemapACES(vec3 color) {
+	const float a = 2.51;
+	const float b = 0.03;
+	const float c = 2.43;
+	const float d = 0.59;
+	const float e = 0.14;
+	return saturate((color * (a * color + b)) / (color * (c * color + d) + e));
+}
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef SKINNING_GLSL
+#define SKINNING_GLSL
+
+layout(std430, set = 1, binding = 8) readonly buffer BoneBuffer {
+	mat4 bones[];
+} boneData;
+
+mat4 skinMatrix(uvec4 joints, vec4 weights) {
+	return boneData.bones[joints.x] * weights.x
+		+ boneData.bones[joints.y] * weights.y
+		+ boneData.bones[joints.z] * weights.z
+		+ boneData.bones[joints.w] * weights.w;
+}
+
+#endif
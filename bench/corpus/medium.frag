@@ -0,0 +1,80 @@
+#version 460
+#include "include/lighting.glsl"
+
+layout(set = 2, binding = 0) uniform sampler2D albedoMap;
+layout(set = 2, binding = 1) uniform sampler2D normalMap;
+layout(set = 2, binding = 2) uniform sampler2D metallicRoughnessMap;
+layout(set = 2, binding = 3) uniform sampler2D occlusionMap;
+layout(set = 2, binding = 4) uniform sampler2D emissiveMap;
+layout(set = 2, binding = 5) uniform samplerCube irradianceMap;
+layout(set = 2, binding = 6) uniform samplerCube prefilteredMap;
+layout(set = 2, binding = 7) uniform sampler2D brdfLUT;
+
+layout(std140, set = 2, binding = 8) uniform MaterialData {
+	vec4 baseColorFactor;
+	vec4 emissiveFactor;
+	float metallicFactor;
+	float roughnessFactor;
+	float normalScale;
+	float alphaCutoff;
+} material;
+
+layout(location = 0) in vec3 inWorldPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec4 inTangent;
+layout(location = 3) in vec2 inUV0;
+layout(location = 4) in vec2 inUV1;
+layout(location = 5) in vec4 inColor;
+
+layout(location = 0) out vec4 outColor;
+layout(location = 1) out vec2 outNormal;
+
+vec3 perturbNormal() {
+	vec3 tangentNormal = texture(normalMap, inUV0).xyz * 2.0 - 1.0;
+	tangentNormal.xy *= material.normalScale;
+	vec3 N = normalize(inNormal);
+	vec3 T = normalize(inTangent.xyz - N * dot(N, inTangent.xyz));
+	vec3 B = cross(N, T) * inTangent.w;
+	return normalize(mat3(T, B, N) * tangentNormal);
+}
+
+vec3 ambientLighting(Surface surface) {
+	float NdotV = max(dot(surface.normal, surface.view), EPSILON);
+	vec3 F0 = mix(vec3(0.04), surface.albedo, surface.metallic);
+	vec3 F = fresnelSchlickRoughness(NdotV, F0, surface.roughness);
+	vec3 kD = (1.0 - F) * (1.0 - surface.metallic);
+
+	vec3 irradiance = texture(irradianceMap, surface.normal).rgb;
+	vec3 diffuse = irradiance * surface.albedo;
+
+	vec3 R = reflect(-surface.view, surface.normal);
+	const float maxLod = 6.0;
+	vec3 prefiltered = textureLod(prefilteredMap, R, surface.roughness * maxLod).rgb;
+	vec2 brdf = texture(brdfLUT, vec2(NdotV, surface.roughness)).rg;
+	vec3 specular = prefiltered * (F * brdf.x + brdf.y);
+
+	return (kD * diffuse + specular) * surface.occlusion;
+}
+
+void main() {
+	vec4 baseColor = texture(albedoMap, inUV0) * material.baseColorFactor * inColor;
+	if (baseColor.a < material.alphaCutoff) {
+		discard;
+	}
+	vec4 metallicRoughness = texture(metallicRoughnessMap, inUV0);
+
+	Surface surface;
+	surface.position = inWorldPosition;
+	surface.normal = perturbNormal();
+	surface.view = normalize(frame.cameraPosition.xyz - inWorldPosition);
+	surface.albedo = baseColor.rgb;
+	surface.metallic = metallicRoughness.b * material.metallicFactor;
+	surface.roughness = clamp(metallicRoughness.g * material.roughnessFactor, 0.04, 1.0);
+	surface.occlusion = texture(occlusionMap, inUV1).r;
+	surface.emissive = texture(emissiveMap, inUV0).rgb * material.emissiveFactor.rgb;
+
+	vec3 color = evaluateLights(surface) + ambientLighting(surface) + surface.emissive;
+	color = tonemapACES(color * frame.exposure);
+	outColor = vec4(linearToSrgb(color), baseColor.a);
+	outNormal = encodeNormal(surface.normal);
+}
@@ -0,0 +1,42 @@
+#version 460
+#include "include/common.glsl"
+#include "include/skinning.glsl"
+
+layout(push_constant) uniform Constants {
+	mat4 model;
+	uint boneOffset;
+} constants;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec3 inNormal;
+layout(location = 2) in vec4 inTangent;
+layout(location = 3) in vec2 inUV0;
+layout(location = 4) in vec2 inUV1;
+layout(location = 5) in uvec4 inJoints;
+layout(location = 6) in vec4 inWeights;
+layout(location = 7) in vec4 inColor;
+
+layout(location = 0) out vec3 outWorldPosition;
+layout(location = 1) out vec3 outNormal;
+layout(location = 2) out vec4 outTangent;
+layout(location = 3) out vec2 outUV0;
+layout(location = 4) out vec2 outUV1;
+layout(location = 5) out vec4 outColor;
+layout(location = 6) out vec4 outPreviousClip;
+
+void main() {
+	mat4 skin = skinMatrix(inJoints + uvec4(constants.boneOffset), inWeights);
+	mat4 world = constants.model * skin;
+	mat3 normalMatrix = transpose(inverse(mat3(world)));
+
+	vec4 worldPosition = world * vec4(inPosition, 1.0);
+	outWorldPosition = worldPosition.xyz;
+	outNormal = normalize(normalMatrix * inNormal);
+	outTangent = vec4(normalize(normalMatrix * inTangent.xyz), inTangent.w);
+	outUV0 = inUV0;
+	outUV1 = inUV1;
+	outColor = vec4(srgbToLinear(inColor.rgb), inColor.a);
+
+	gl_Position = frame.viewProjection * worldPosition;
+	outPreviousClip = gl_Position;
+}
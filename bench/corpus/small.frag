@@ -0,0 +1,14 @@
+#version 460
+
+layout(set = 0, binding = 2) uniform sampler2D albedo;
+
+layout(push_constant) uniform Constants {
+	vec4 tint;
+} constants;
+
+layout(location = 0) in vec2 inUV;
+layout(location = 0) out vec4 outColor;
+
+void main() {
+	outColor = texture(albedo, inUV) * constants.tint;
+}
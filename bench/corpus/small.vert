@@ -0,0 +1,16 @@
+#version 460
+#include "include/common.glsl"
+
+layout(push_constant) uniform Constants {
+	mat4 model;
+} constants;
+
+layout(location = 0) in vec3 inPosition;
+layout(location = 1) in vec2 inUV;
+
+layout(location = 0) out vec2 outUV;
+
+void main() {
+	outUV = inUV;
+	gl_Position = frame.viewProjection * constants.model * vec4(inPosition, 1.0);
+}
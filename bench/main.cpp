@@ -0,0 +1,32 @@
+#include "Bench.hpp"
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+int main(int argc, char** argv){
+	struct Benchmark{
+		const char* name;
+		int (*run)();
+	};
+	const Benchmark benchmarks[] = {
+		{"reflection", bench::RunReflectionBench},
+		{"archive", bench::RunArchiveBench},
+		{"optimization", bench::RunOptimizationBench},
+		{"corpus", bench::RunCorpusBench},
+		{"scaling", bench::RunScalingBench},
+	};
+
+	// with no arguments run everything, otherwise only the benchmarks named on the command line
+	int status = 0;
+	for (const auto& benchmark : benchmarks){
+		bool selected = argc < 2;
+		for (int i = 1; i < argc; i++){
+			selected |= strcmp(argv[i], benchmark.name) == 0;
+		}
+		if (selected){
+			status |= benchmark.run();
+		}
+	}
+	return status;
+}
@@ -2,7 +2,18 @@
 #include <string>
 #include <vector>
 #include <array>
+#include <chrono>
 #include <filesystem>
+#include <variant>
+#include <optional>
+#include <map>
+#include <future>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <iosfwd>
 
 
 namespace spirv_cross{
@@ -56,6 +67,14 @@ struct ReflectData{
 		uint32_t type_id;
 		uint32_t base_type_id;
 		std::string name;
+		// decorations on the variable, or Unassigned if it does not have one.
+		// For Metal, binding is instead the [[buffer]], [[texture]] or [[sampler]] index the resource was assigned.
+		uint32_t set = Unassigned;
+		uint32_t binding = Unassigned;
+		uint32_t location = Unassigned;
+		uint32_t samplerBinding = Unassigned;	// Metal only: the [[sampler]] index of a combined image sampler
+		static constexpr uint32_t Unassigned = ~0u;
+		Resource() = default;
 		Resource(const spirv_cross::Resource&);
 	};
 	std::vector<Resource> uniform_buffers;
@@ -80,6 +99,132 @@ struct ReflectData{
     std::array<uint16_t,3> compute_dim{};
 };
 
+/**
+ Read-only access to reflection data stored in columns: each resource field is one contiguous array, with the resource
+ types laid out one after another, and names are offsets into a single string table. This does not own its storage.
+ */
+class ReflectionView{
+public:
+	enum class ResourceType : uint8_t{
+		UniformBuffers,
+		StorageBuffers,
+		StageInputs,
+		StageOutputs,
+		SubpassInputs,
+		StorageImages,
+		SampledImages,
+		AtomicCounters,
+		AccelerationStructures,
+		PushConstantBuffers,
+		SeparateImages,
+		SeparateSamplers,
+		Count
+	};
+
+	/**
+	 @return the reflection data in the layout of ReflectData
+	 */
+	ReflectData ToReflectData() const;
+
+	/**
+	 @return the number of resources of a type
+	 */
+	size_t Size(ResourceType type) const{
+		return listStart[size_t(type) + 1] - listStart[size_t(type)];
+	}
+
+	uint32_t Id(ResourceType type, size_t index) const{
+		return column(IdColumn, type, index);
+	}
+	uint32_t TypeId(ResourceType type, size_t index) const{
+		return column(TypeIdColumn, type, index);
+	}
+	uint32_t BaseTypeId(ResourceType type, size_t index) const{
+		return column(BaseTypeIdColumn, type, index);
+	}
+	uint32_t Set(ResourceType type, size_t index) const{
+		return column(SetColumn, type, index);
+	}
+	uint32_t Binding(ResourceType type, size_t index) const{
+		return column(BindingColumn, type, index);
+	}
+	uint32_t Location(ResourceType type, size_t index) const{
+		return column(LocationColumn, type, index);
+	}
+	uint32_t SamplerBinding(ResourceType type, size_t index) const{
+		return column(SamplerBindingColumn, type, index);
+	}
+	/**
+	 @return the name of a resource. The view is valid for as long as the storage behind this object.
+	 */
+	std::string_view Name(ResourceType type, size_t index) const{
+		return names.substr(column(NameOffsetColumn, type, index), column(NameLengthColumn, type, index));
+	}
+
+	const std::array<uint16_t,3>& ComputeDim() const{
+		return computeDim;
+	}
+
+protected:
+	enum Column : uint8_t{
+		IdColumn,
+		TypeIdColumn,
+		BaseTypeIdColumn,
+		SetColumn,
+		BindingColumn,
+		LocationColumn,
+		SamplerBindingColumn,
+		NameOffsetColumn,
+		NameLengthColumn,
+		NumColumns
+	};
+	static constexpr size_t NumListStarts = size_t(ResourceType::Count) + 1;
+
+	ReflectionView() = default;
+	ReflectionView(const uint32_t* listStart, const uint32_t* columns, std::string_view names, const std::array<uint16_t,3>& computeDim) :
+		listStart(listStart), columns(columns), names(names), computeDim(computeDim){}
+
+	uint32_t column(Column col, ResourceType type, size_t index) const{
+		return columns[size_t(col) * listStart[NumListStarts - 1] + listStart[size_t(type)] + index];
+	}
+
+	static constexpr uint32_t noResources[NumListStarts]{};
+
+	const uint32_t* listStart = noResources;	// index of the first resource of each type, then the total
+	const uint32_t* columns = nullptr;			// NumColumns columns of listStart[NumListStarts - 1] entries each
+	std::string_view names;
+	std::array<uint16_t,3> computeDim{};
+
+	friend class ShaderView;
+	friend class ShaderArchiveWriter;
+};
+
+/**
+ A compact, read-only layout of ReflectData for keeping the reflection of many shaders in memory.
+ Every distinct name is stored once.
+ */
+class CompactReflectData : public ReflectionView{
+public:
+	CompactReflectData() = default;
+	explicit CompactReflectData(const ReflectData& data);
+	CompactReflectData(const CompactReflectData& other);
+	CompactReflectData(CompactReflectData&& other) noexcept;
+	CompactReflectData& operator=(const CompactReflectData& other);
+	CompactReflectData& operator=(CompactReflectData&& other) noexcept;
+
+	/**
+	 @return the number of bytes this object occupies, including its heap storage
+	 */
+	size_t MemoryUsage() const;
+
+private:
+	void bind();
+
+	std::array<uint32_t, NumListStarts> listStorage{};
+	std::vector<uint32_t> columnStorage;
+	std::string nameStorage;
+};
+
 struct Uniform
 {
 	std::string name;
@@ -96,21 +241,394 @@ struct LiveAttribute {
 };
 
 
+/**
+ Read-only view of an array of SPIR-V words
+ */
+class WordView{
+public:
+	WordView() = default;
+	WordView(const uint32_t* data, size_t size) : words(data), count(size){}
+
+	const uint32_t* data() const{
+		return words;
+	}
+	size_t size() const{
+		return count;
+	}
+	bool empty() const{
+		return count == 0;
+	}
+	const uint32_t* begin() const{
+		return words;
+	}
+	const uint32_t* end() const{
+		return words + count;
+	}
+	uint32_t operator[](size_t index) const{
+		return words[index];
+	}
+
+private:
+	const uint32_t* words = nullptr;
+	size_t count = 0;
+};
+
+/**
+ Owned, read-only binary output such as SPIR-V, DXIL or a metallib. The buffer adopts the storage its producer
+ allocated instead of copying it, and copies of the buffer share that storage.
+ */
+class BinaryBuffer{
+public:
+	BinaryBuffer() = default;
+
+	/**
+	 Take ownership of SPIR-V words without copying them
+	 */
+	explicit BinaryBuffer(spirvbytes words);
+
+	/**
+	 Refer to bytes kept alive by another object, for example a compiler's output blob
+	 @param owner released when the last copy of this buffer is destroyed
+	 @param data the first byte
+	 @param size the number of bytes
+	 */
+	BinaryBuffer(std::shared_ptr<const void> owner, const void* data, size_t size) :
+		owner(std::move(owner)), bytes(static_cast<const char*>(data)), count(size){}
+
+	/**
+	 @return a buffer holding a copy of bytes
+	 */
+	static BinaryBuffer Copy(std::string_view bytes);
+
+	const char* data() const{
+		return bytes;
+	}
+	size_t size() const{
+		return count;
+	}
+	bool empty() const{
+		return count == 0;
+	}
+
+	std::string_view Bytes() const{
+		return {bytes, count};
+	}
+	operator std::string_view() const{
+		return Bytes();
+	}
+
+	/**
+	 @return the buffer as SPIR-V words, or an empty view if it is not a whole number of aligned words
+	 */
+	WordView Words() const;
+
+private:
+	std::shared_ptr<const void> owner;
+	const char* bytes = nullptr;
+	size_t count = 0;
+};
+
+/**
+ Owned, read-only text output such as GLSL, HLSL or MSL. Copies share one string, like BinaryBuffer, so results that
+ reuse another result's output do not duplicate it. Converts to const std::string& for code that expects a string.
+ */
+class TextBuffer{
+public:
+	TextBuffer() = default;
+	explicit TextBuffer(std::string text) : text(std::make_shared<const std::string>(std::move(text))){}
+
+	const std::string& str() const{
+		return text ? *text : EmptyString();
+	}
+	operator const std::string&() const{
+		return str();
+	}
+	operator std::string_view() const{
+		return str();
+	}
+
+	const char* data() const{
+		return str().data();
+	}
+	const char* c_str() const{
+		return str().c_str();
+	}
+	size_t size() const{
+		return str().size();
+	}
+	bool empty() const{
+		return str().empty();
+	}
+
+	friend bool operator==(const TextBuffer& a, const TextBuffer& b){
+		return a.text == b.text || a.str() == b.str();
+	}
+	friend bool operator!=(const TextBuffer& a, const TextBuffer& b){
+		return !(a == b);
+	}
+	friend bool operator==(const TextBuffer& a, std::string_view b){
+		return a.str() == b;
+	}
+	friend bool operator==(std::string_view a, const TextBuffer& b){
+		return a == b.str();
+	}
+	friend bool operator!=(const TextBuffer& a, std::string_view b){
+		return !(a == b);
+	}
+	friend bool operator!=(std::string_view a, const TextBuffer& b){
+		return !(a == b);
+	}
+	friend std::ostream& operator<<(std::ostream& stream, const TextBuffer& buffer);
+
+private:
+	static const std::string& EmptyString();
+
+	std::shared_ptr<const std::string> text;
+};
+
 struct IMResult{
-	std::string sourceData, binaryData;
+	TextBuffer sourceData;
+	BinaryBuffer binaryData;
 	ReflectData reflectData;
 	std::vector<Uniform> uniformData;
 	std::vector<LiveAttribute> attributeData;
 };
 
+struct IncludeDependency{
+	std::filesystem::path path;		// absolute
+	std::string contentHash;		// hex SHA-256 of the file, empty unless Options::hashIncludes is set
+};
+
+/**
+ What one SPIR-V optimizer pass cost. The memory figures are for the whole process, and are -1 where they could not be measured.
+ */
+struct OptimizerPassStats{
+	std::string name;				// the pass name, as spirv-opt prints it
+	uint32_t runs = 1;				// how many times the pass ran. An optimization level runs some passes several times.
+	double wallSeconds = 0;
+	double cpuSeconds = 0;			// CPU time of the whole process, so other threads compiling at once inflate it
+	int64_t peakRssGrowthKB = 0;	// how much the peak resident set of the process grew
+	int64_t pageFaults = 0;
+};
+
+/**
+ The stages of the compile pipeline that CompileStats times
+ */
+enum class CompileStage : uint8_t{
+	Parse,				// glslang preprocessing and parsing, including reading includes
+	Link,				// glslang program linking
+	SpirvGeneration,	// GlslangToSpv
+	GlslReflection,		// glslang reflection, for uniformData and attributeData
+	Optimization,		// the SPIR-V optimizer
+	CrossCompile,		// SPIRV-Cross or Tint writing the target language
+	Reflection,			// reflectData
+	BinaryCompile,		// DXC for DXIL, or the Metal compiler for MetalBinary
+	Count
+};
+
+/**
+ @return a short name for a stage, such as "parse"
+ */
+const char* StageName(CompileStage stage);
+
+/**
+ Memory used by a stage or a compile. Allocations are only counted when the library is built with ST_ENABLE_MEMORY_STATS,
+ which replaces the program's global operator new and delete. SPIRV-Cross takes some of its memory with malloc, which only
+ shows up in peakResidentGrowthKB.
+ */
+struct MemoryUsage{
+	uint64_t allocations = 0;
+	uint64_t bytesAllocated = 0;
+	uint64_t peakHeapGrowth = 0;		// the most bytes the compiling thread held at once, above what it held at the start
+	int64_t peakResidentGrowthKB = 0;	// growth of the peak resident set of the process, so other threads count too
+};
+
+/**
+ What one compile cost. A stage's time and allocations do not include the stages that ran inside it, such as reflection inside the
+ cross compiler. Stages that did not run in this call are zero, for example the front end for every target after
+ the first in CompileToMany.
+ */
+struct CompileStats{
+	std::array<std::chrono::nanoseconds, size_t(CompileStage::Count)> stageDurations{};
+	std::chrono::nanoseconds total{};		// from looking up the caches until the result was ready
+	bool cached = false;					// the result came from the memory or disk cache, so no stage ran
+	uint64_t inputBytes = 0;				// the source, without its includes
+	uint64_t outputBytes = 0;				// sourceData plus binaryData
+	uint64_t spirvWords = 0;				// the front end's SPIR-V. 0 if cached.
+	uint64_t optimizedSpirvWords = 0;		// 0 if the SPIR-V was not optimized in this call
+	uint32_t includeCount = 0;				// files #included, transitively
+
+	// Time this call spent blocked on the library's own locks: the caches, batch deduplication and tracing. glslang's
+	// internal locks are not visible here; contention on them shows up as a longer parse stage.
+	std::chrono::nanoseconds lockWait{};
+
+	// The peaks of a stage include the stages nested inside it
+	std::array<MemoryUsage, size_t(CompileStage::Count)> stageMemory{};
+	MemoryUsage memory;						// the whole call
+	bool allocationsCounted = false;		// whether the library was built with ST_ENABLE_MEMORY_STATS
+
+	std::chrono::nanoseconds Duration(CompileStage stage) const{
+		return stageDurations[size_t(stage)];
+	}
+	const MemoryUsage& Memory(CompileStage stage) const{
+		return stageMemory[size_t(stage)];
+	}
+};
+
 struct CompileResult{
 	IMResult data;
+	std::vector<IncludeDependency> includes;	// every file #included while compiling, transitively
+
+	// One entry per optimizer pass run, in order, when Options::reportOptimizerPasses is set. Empty if the compile
+	// did not optimize: a cache hit, a duplicate in a batch, a target of CompileToMany that reused the SPIR-V optimized for an
+	// earlier target, or SPIRV-Tools built without timers (it has them on Linux and Android).
+	std::vector<OptimizerPassStats> optimizerPasses;
+
+	std::optional<CompileStats> stats;		// set when Options::collectStats is set
+};
+
+/**
+ A Uniform whose name points into a ShaderArchive
+ */
+struct UniformView{
+	std::string_view name;
+	int glDefineType = 0;
+	uint8_t arraySize = 0;
+	uint16_t bufferOffset = 0;
+	uint8_t texComponent = 0;
+	uint8_t texDimension = 0;
+	uint16_t texFormat = 0;
+};
+
+/**
+ One CompileResult inside a ShaderArchive. Every accessor returns a view into the archive's storage without
+ allocating, so views are only valid while the archive (or a copy of it) is alive.
+ */
+class ShaderView{
+public:
+	std::string_view SourceData() const;
+	std::string_view BinaryData() const;
+
+	/**
+	 @return binaryData as SPIR-V words, for results compiled to Vulkan
+	 */
+	WordView SpirvWords() const;
+
+	const ReflectionView& Reflection() const{
+		return reflection;
+	}
+
+	size_t UniformCount() const;
+	UniformView Uniform(size_t index) const;
+
+	size_t AttributeCount() const;
+	std::string_view Attribute(size_t index) const;
+
+	size_t IncludeCount() const;
+	std::string_view IncludePath(size_t index) const;
+	std::string_view IncludeHash(size_t index) const;
+
+	/**
+	 @return a copy of the result that does not depend on the archive
+	 */
+	CompileResult ToCompileResult() const;
+
+private:
+	ShaderView(const char* record, size_t size);
+
+	const char* record = nullptr;
+	std::string_view strings;
+	ReflectionView reflection;
+
+	friend class ShaderArchive;
+};
+
+/**
+ Builds a ShaderArchive: a versioned, aligned file of CompileResults that can be memory-mapped and read in place.
+ Each result is stored under a key, for example the shader's name, target and variant.
+ */
+class ShaderArchiveWriter{
+public:
+	/**
+	 Add a result to the archive
+	 @param key the name to look the result up by. Keys must be unique.
+	 @param result the result to store
+	 */
+	void Add(std::string key, const CompileResult& result);
+
+	/**
+	 @return the bytes of the archive
+	 */
+	std::string Finish() const;
+
+	/**
+	 Write the archive to a file. Throws on failure.
+	 */
+	void Write(const std::filesystem::path& path) const;
+
+private:
+	static std::string encode(const CompileResult& result);
+
+	std::vector<std::pair<std::string, std::string>> entries;	// key, encoded result
+};
+
+/**
+ Reads an archive written by ShaderArchiveWriter. Lookups by key go through a hash index stored in the file,
+ and results are read in place, so loading a shader is a lookup and a few pointer adjustments.
+ Copies share the same storage.
+ */
+class ShaderArchive{
+public:
+	ShaderArchive() = default;
+
+	/**
+	 Map an archive file into memory. Throws if the file cannot be read or is not a valid archive.
+	 */
+	static ShaderArchive Open(const std::filesystem::path& path);
+
+	/**
+	 Read an archive from memory without copying it
+	 @param bytes the archive. It must be aligned to 8 bytes and must outlive the ShaderArchive and its views.
+	 */
+	static ShaderArchive FromBytes(std::string_view bytes);
+
+	/**
+	 @return the number of results in the archive
+	 */
+	size_t Size() const;
+
+	std::string_view Key(size_t index) const;
+	ShaderView At(size_t index) const;
+
+	/**
+	 @return the result stored under key, or nothing if there is none
+	 */
+	std::optional<ShaderView> Find(std::string_view key) const;
+
+private:
+	explicit ShaderArchive(std::string_view bytes, std::shared_ptr<const void> storage = nullptr);
+
+	std::string_view bytes;
+	std::shared_ptr<const void> storage;
+};
+
+/**
+ How the SPIR-V is optimized before it is handed to a backend
+ */
+enum class OptimizationLevel : uint8_t{
+	Default,		// Vulkan: the size, performance and legalization passes. Other targets: None.
+	None,			// the front end's SPIR-V as-is
+	Size,			// spirv-opt -Os
+	Performance,	// spirv-opt -O
+	Custom			// the passes in Options::optimizerPasses
 };
 
 struct Options{
 	uint32_t version;
 	bool mobile;
-	bool debug = false;
+	bool debug = false;		// keep debug info. Debug compiles are not optimized.
+	OptimizationLevel optimization = OptimizationLevel::Default;
+	std::vector<std::string> optimizerPasses;	// spirv-opt flags for OptimizationLevel::Custom, for example "--eliminate-dead-code-aggressive"
 	bool enableInclude = true;
 	std::string entryPoint = "frag";
 	struct UniformBufferSettings{
@@ -130,7 +648,9 @@ struct Options{
     
     struct PushConstantSettings{
         uint8_t firstIndex = 0;
-        
+        // WGSL has no push constants, so they become a uniform buffer at this descriptor set and binding
+        uint32_t uniformBufferSet = 0;
+        uint32_t uniformBufferBinding = 0;
     } pushConstantSettings;
     
     struct BufferBindingSettings{
@@ -138,10 +658,145 @@ struct Options{
         
     } bufferBindingSettings;
     std::string preambleContent;   // Put defines here
+    bool hashIncludes = false;      // fill in IncludeDependency::contentHash
+    bool reportOptimizerPasses = false;	// fill in CompileResult::optimizerPasses
+    bool collectStats = false;		// fill in CompileResult::stats
+};
+
+struct CompileJob{
+	std::variant<FileCompileTask, MemoryCompileTask> task;	// FileCompileTask::filename must outlive the batch
+	TargetAPI platform;
+	Options options;
+};
+
+struct BatchResult{
+	CompileResult result;
+	std::string error;			// the failure reason if succeeded is false
+	bool succeeded = false;
+	
+	// Set if the backend output (sourceData, binaryData, reflectData) is identical to that of another result in the
+	// same call, which was reused instead of compiling again. This is the job index for CompileBatch and the variant
+	// mask for CompileVariants.
+	std::optional<uint64_t> duplicateOf;
+};
+
+/**
+ Thrown from CompileHandle::result when a compile is cancelled
+ */
+struct CompileCancelled : public std::runtime_error{
+	using std::runtime_error::runtime_error;
 };
 
+struct CompileHandle{
+	std::future<CompileResult> result;	// get() rethrows compile errors, or CompileCancelled
+	std::shared_ptr<std::atomic<bool>> cancelled = std::make_shared<std::atomic<bool>>(false);
+
+	/**
+	 Request that the compile stop. The compile checks this between pipeline stages,
+	 so work already inside a stage finishes first.
+	 */
+	void Cancel(){
+		*cancelled = true;
+	}
+};
+
+struct CacheCounters{
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	uint64_t evictions = 0;
+	uint64_t rejected = 0;		// inserts dropped because the item alone was larger than the cache
+	uint64_t entries = 0;
+	uint64_t bytes = 0;
+};
+
+struct MemoryCacheStatistics{
+	CacheCounters spirv;		// front-end output, shared by every target API
+	CacheCounters results;		// final per-target CompileResults
+};
+
+/**
+ A timeline of compiles, for seeing where the time of a large build went in chrome://tracing or Perfetto:
+ which shaders were on the critical path, where threads sat idle, and which stage each compile was in.
+ Attach one with ShaderTranspiler::SetTrace. Safe to record into from many threads at once.
+ */
+class CompileTrace{
+public:
+	struct Event{
+		std::string name;		// the shader's file name for a whole compile, or the StageName of a stage inside it
+		std::string shader;		// the shader's file name
+		std::optional<TargetAPI> target;	// set for whole compiles
+		uint32_t threadId = 0;	// see CurrentThread
+		std::chrono::steady_clock::time_point start, end;
+	};
+
+	/**
+	 Add an event, for example to show your own work next to the compiles
+	 */
+	void Record(Event event);
+
+	/**
+	 @return every event so far, in the order they ended
+	 */
+	std::vector<Event> Events() const;
+
+	void Clear();
+
+	/**
+	 @return the events as Chrome trace JSON, with times relative to the earliest event
+	 */
+	std::string ToChromeJSON() const;
+
+	/**
+	 Write the events to a file as Chrome trace JSON. Throws if the file cannot be written.
+	 */
+	void WriteChromeJSON(const std::filesystem::path& path) const;
+
+	/**
+	 @return a small number identifying the calling thread in events, assigned on first use
+	 */
+	static uint32_t CurrentThread();
+
+private:
+	mutable std::mutex mtx;
+	std::vector<Event> events;
+};
+
+struct TranspilerState;
+
+/**
+ Create the text of a Makefile / Ninja depfile listing the includes of a compile
+ @param target the output file that depends on the includes
+ @param result the result of compiling target
+ @return the depfile contents
+ */
+std::string MakeDepfile(const std::filesystem::path& target, const CompileResult& result);
+
+/**
+ Write a Makefile / Ninja depfile listing the includes of a compile, so that the build only reruns it when one of them changes
+ @param depfile where to write the depfile
+ @param target the output file that depends on the includes
+ @param result the result of compiling target
+ */
+void WriteDepfile(const std::filesystem::path& depfile, const std::filesystem::path& target, const CompileResult& result);
+
+/**
+ Add up the optimizer passes of many compiles, to find the passes that cost the most
+ @param results the results of a batch. Failed compiles are skipped.
+ @return one entry per pass name, with the highest wallSeconds first
+ */
+std::vector<OptimizerPassStats> AggregateOptimizerPasses(const std::vector<BatchResult>& results);
+
+/**
+ Add up the optimizer passes of many compiles, to find the passes that cost the most
+ @param results for example the output of CompileToMany
+ @return one entry per pass name, with the highest wallSeconds first
+ */
+std::vector<OptimizerPassStats> AggregateOptimizerPasses(const std::vector<CompileResult>& results);
+
 class ShaderTranspiler{
 public:
+	ShaderTranspiler();
+
     /**
     Execute the shader transpiler using shader source code in a file.
      @param task the CompileTask to execute. See CompileTask for information.
@@ -158,6 +813,111 @@ public:
 	 */
 	CompileResult CompileTo(const MemoryCompileTask& task, const TargetAPI platform, const Options& options);
 
+	/**
+	Execute the shader transpiler for several target APIs at once using shader source code in a file.
+	The GLSL front end runs once and its SPIR-V is shared by every backend.
+	 @param task the CompileTask to execute. See CompileTask for information.
+	 @param platforms the target APIs to compile to.
+	 @return One CompileResult per entry in platforms, in the same order.
+	 */
+	std::vector<CompileResult> CompileToMany(const FileCompileTask& task, const std::vector<TargetAPI>& platforms, const Options& options);
+
+	/**
+	Execute the shader transpiler for several target APIs at once using shader source code in memory.
+	The GLSL front end runs once and its SPIR-V is shared by every backend.
+	 @param task the CompileTask to execute. See CompileTask for information.
+	 @param platforms the target APIs to compile to.
+	 @return One CompileResult per entry in platforms, in the same order.
+	 */
+	std::vector<CompileResult> CompileToMany(const MemoryCompileTask& task, const std::vector<TargetAPI>& platforms, const Options& options);
+
+	/**
+	Execute the shader transpiler on the library's thread pool using shader source code in a file.
+	The task is copied, so it does not need to outlive this call.
+	 @param task the CompileTask to execute. See CompileTask for information.
+	 @param platform the target API to compile to.
+	 @return A CompileHandle to wait on or cancel the compile.
+	 */
+	CompileHandle CompileToAsync(const FileCompileTask& task, const TargetAPI platform, const Options& options);
+
+	/**
+	Execute the shader transpiler on the library's thread pool using shader source code in memory.
+	The task is copied, so it does not need to outlive this call.
+	 @param task the CompileTask to execute. See CompileTask for information.
+	 @param platform the target API to compile to.
+	 @return A CompileHandle to wait on or cancel the compile.
+	 */
+	CompileHandle CompileToAsync(const MemoryCompileTask& task, const TargetAPI platform, const Options& options);
+
+	/**
+	Execute many compiles in parallel on the library's thread pool. This function blocks until every job has finished.
+	 @param jobs the tasks to execute, each with its own target API and Options.
+	 @return One BatchResult per job, in the same order. A failing job does not affect the others.
+	 */
+	std::vector<BatchResult> CompileBatch(const std::vector<CompileJob>& jobs);
+
+	/**
+	Compile permutations of a shader in a file in parallel. Each variant enables a subset of the defines,
+	which are appended to Options::preambleContent.
+	 @param task the CompileTask to execute. See CompileTask for information.
+	 @param platform the target API to compile to.
+	 @param defines the define axes, as NAME or NAME=VALUE. Bit i of a variant mask enables defines[i].
+	 @param variants the masks to compile. Leave empty to compile every combination of the defines.
+	 @return One BatchResult per variant, keyed by its mask.
+	 */
+	std::map<uint64_t, BatchResult> CompileVariants(const FileCompileTask& task, const TargetAPI platform, const Options& options, const std::vector<std::string>& defines, const std::vector<uint64_t>& variants = {});
+
+	/**
+	Compile permutations of a shader in memory in parallel. Each variant enables a subset of the defines,
+	which are appended to Options::preambleContent.
+	 @param task the CompileTask to execute. See CompileTask for information.
+	 @param platform the target API to compile to.
+	 @param defines the define axes, as NAME or NAME=VALUE. Bit i of a variant mask enables defines[i].
+	 @param variants the masks to compile. Leave empty to compile every combination of the defines.
+	 @return One BatchResult per variant, keyed by its mask.
+	 */
+	std::map<uint64_t, BatchResult> CompileVariants(const MemoryCompileTask& task, const TargetAPI platform, const Options& options, const std::vector<std::string>& defines, const std::vector<uint64_t>& variants = {});
+
+	/**
+	Build glslang's built-in symbol tables ahead of time, so the first compile of each stage and GLSL version
+	is as fast as later ones. Blocks until done. Calling this more than once is cheap.
+	 @param stages the stages that will be compiled
+	 @param glslVersions the #version values that the shaders will use
+	 */
+	static void WarmUp(const std::vector<ShaderStage>& stages, const std::vector<uint32_t>& glslVersions = {460});
+
+	/**
+	Cache compile results on disk. The cache is keyed by the source, the contents of every included file, the Options,
+	the target API, the stage, and the versions of the libraries: glslang, SPIRV-Tools, SPIRV-Cross, SPIRV-Reflect, Tint
+	and a bundled DXC. The DXC that comes with Windows is not part of the key, so clear the cache after updating it.
+	Several processes may share one cache directory.
+	 @param directory where to store the cache. Pass an empty path to turn the cache off.
+	 @param maxBytes the size limit for the directory. Least recently used entries are deleted past this. 0 means unlimited.
+	 */
+	void SetDiskCache(const std::filesystem::path& directory, uint64_t maxBytes = 0);
+
+	/**
+	Keep recent front-end SPIR-V and compile results in memory, so that repeating a compile is nearly free.
+	Entries are dropped if a file they included has changed on disk. Safe to use from many threads at once.
+	 @param maxBytes the memory budget for the cache, split evenly between SPIR-V and results. An item larger than its half
+	 is not cached. Pass 0 to turn the cache off and free its memory.
+	 */
+	void EnableMemoryCache(size_t maxBytes);
+
+	/**
+	 @return the hit, miss and eviction counts for the memory cache. All zero if it is off.
+	 */
+	MemoryCacheStatistics GetMemoryCacheStatistics() const;
+
+	/**
+	Record a CompileTrace event for every compile and each of its stages, from now on
+	 @param trace where to record. Pass nullptr to stop tracing.
+	 */
+	void SetTrace(std::shared_ptr<CompileTrace> trace);
+
 	~ShaderTranspiler();
+
+private:
+	std::shared_ptr<TranspilerState> state;	// copies of a ShaderTranspiler share their caches
 };
 }
@@ -1,11 +1,13 @@
 #include "ShaderTranspiler.hpp"
+#include "SpirvModule.hpp"
+#include "PipelineContext.hpp"
 #include <spirv_msl.hpp>
 #import <Foundation/Foundation.h>
 #include <TargetConditionals.h>
 
 using namespace shadert;
 
-extern IMResult SPIRVtoMSL(const spirvbytes& bin, const Options& opt, spv::ExecutionModel model);
+extern IMResult SPIRVtoMSL(const PipelineContext& ctx, const SpirvModule& module, const Options& opt, spv::ExecutionModel model);
 
 struct executeProcessResult{
 	int code = 0;
@@ -53,10 +55,11 @@ executeProcessResult executeProcess(NSString* launchPath, NSArray<NSString*>* ar
 #endif
 }
 
-IMResult SPIRVtoMBL(const spirvbytes& bin, const Options& opt, spv::ExecutionModel model){
+IMResult SPIRVtoMBL(const PipelineContext& ctx, const SpirvModule& module, const Options& opt, spv::ExecutionModel model){
 #if !TARGET_OS_IPHONE
 	// first make metal source shader
-	auto MSLResult = SPIRVtoMSL(bin, opt, model);
+	auto MSLResult = SPIRVtoMSL(ctx, module, opt, model);
+	StageScope stage(ctx, CompileStage::BinaryCompile);
 	
 	// create the AIR
 	// the "-" argument tells it to read from stdin
@@ -71,11 +74,10 @@ IMResult SPIRVtoMBL(const spirvbytes& bin, const Options& opt, spv::ExecutionMod
 		NSString* fileName = [[NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]] stringByAppendingPathExtension:@"mtllib"];
 		auto mtllibResult = executeProcess(@"/usr/bin/xcrun", @[@"-sdk",@"macosx",@"metallib",@"-",@"-o",fileName], airResult.outdata);
 		if (mtllibResult.code == 0){
-			using binary_t = decltype(MSLResult.binaryData)::value_type;
 			NSData* data = [NSData dataWithContentsOfFile:fileName];
 			
-			// this time the output is the final metallib
-			MSLResult.binaryData.assign((binary_t*)data.bytes, (binary_t*)data.bytes + data.length);
+			// this time the output is the final metallib. The result retains the NSData instead of copying its bytes.
+			MSLResult.binaryData = BinaryBuffer(std::shared_ptr<const void>(CFBridgingRetain(data), [](const void* owned){ CFRelease(owned); }), data.bytes, data.length);
 			
 			// delete the temporary
 			[NSFileManager.defaultManager removeItemAtPath:fileName error:nil];
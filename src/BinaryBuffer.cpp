@@ -0,0 +1,29 @@
+#include <ShaderTranspiler.hpp>
+#include <cstring>
+
+using namespace shadert;
+
+BinaryBuffer::BinaryBuffer(spirvbytes words){
+	auto storage = std::make_shared<const spirvbytes>(std::move(words));
+	bytes = reinterpret_cast<const char*>(storage->data());
+	count = storage->size() * sizeof(uint32_t);
+	owner = std::move(storage);
+}
+
+BinaryBuffer BinaryBuffer::Copy(std::string_view bytes){
+	// word storage, so the copy can always be read as SPIR-V
+	spirvbytes words((bytes.size() + sizeof(uint32_t) - 1) / sizeof(uint32_t));
+	if (!bytes.empty()){
+		std::memcpy(words.data(), bytes.data(), bytes.size());
+	}
+	BinaryBuffer buffer(std::move(words));
+	buffer.count = bytes.size();
+	return buffer;
+}
+
+WordView BinaryBuffer::Words() const{
+	if (count % sizeof(uint32_t) != 0 || reinterpret_cast<uintptr_t>(bytes) % alignof(uint32_t) != 0){
+		return {};
+	}
+	return {reinterpret_cast<const uint32_t*>(bytes), count / sizeof(uint32_t)};
+}
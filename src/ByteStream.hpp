@@ -0,0 +1,71 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace shadert{
+
+/**
+ Append-only little helper for writing binary records
+ */
+class ByteWriter{
+public:
+	template<typename T>
+	void Value(const T& value){
+		static_assert(std::is_trivially_copyable_v<T>);
+		out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+	}
+
+	void String(std::string_view str){
+		Value(uint64_t(str.size()));
+		out.append(str);
+	}
+
+	std::string& Data(){
+		return out;
+	}
+
+private:
+	std::string out;
+};
+
+/**
+ Bounds-checked reader for records written with ByteWriter. Every read returns false once the data runs out.
+ */
+class ByteReader{
+public:
+	explicit ByteReader(std::string_view data) : data(data){}
+
+	template<typename T>
+	bool Value(T& value){
+		static_assert(std::is_trivially_copyable_v<T>);
+		if (data.size() - pos < sizeof(value)){
+			return false;
+		}
+		std::memcpy(&value, data.data() + pos, sizeof(value));
+		pos += sizeof(value);
+		return true;
+	}
+
+	bool String(std::string& str){
+		uint64_t size = 0;
+		if (!Value(size) || data.size() - pos < size){
+			return false;
+		}
+		str.assign(data.data() + pos, size);
+		pos += size;
+		return true;
+	}
+
+	bool AtEnd() const{
+		return pos == data.size();
+	}
+
+private:
+	std::string_view data;
+	size_t pos = 0;
+};
+
+}
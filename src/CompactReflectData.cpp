@@ -0,0 +1,120 @@
+#include <ShaderTranspiler.hpp>
+#include <unordered_map>
+
+using namespace shadert;
+
+using ResourceType = ReflectionView::ResourceType;
+
+// the ReflectData member holding each resource type, in ResourceType order
+static constexpr std::array<std::vector<ReflectData::Resource> ReflectData::*, size_t(ResourceType::Count)> resourceLists{
+	&ReflectData::uniform_buffers,
+	&ReflectData::storage_buffers,
+	&ReflectData::stage_inputs,
+	&ReflectData::stage_outputs,
+	&ReflectData::subpass_inputs,
+	&ReflectData::storage_images,
+	&ReflectData::sampled_images,
+	&ReflectData::atomic_counters,
+	&ReflectData::acceleration_structures,
+	&ReflectData::push_constant_buffers,
+	&ReflectData::separate_images,
+	&ReflectData::separate_samplers,
+};
+
+ReflectData ReflectionView::ToReflectData() const{
+	ReflectData data;
+	for (size_t type = 0; type < resourceLists.size(); type++){
+		const auto resourceType = ResourceType(type);
+		auto& list = data.*resourceLists[type];
+		list.reserve(Size(resourceType));
+		for (size_t i = 0; i < Size(resourceType); i++){
+			ReflectData::Resource resource;
+			resource.id = Id(resourceType, i);
+			resource.type_id = TypeId(resourceType, i);
+			resource.base_type_id = BaseTypeId(resourceType, i);
+			resource.name = Name(resourceType, i);
+			resource.set = Set(resourceType, i);
+			resource.binding = Binding(resourceType, i);
+			resource.location = Location(resourceType, i);
+			resource.samplerBinding = SamplerBinding(resourceType, i);
+			list.push_back(std::move(resource));
+		}
+	}
+	data.compute_dim = computeDim;
+	return data;
+}
+
+CompactReflectData::CompactReflectData(const ReflectData& data){
+	for (size_t type = 0; type < resourceLists.size(); type++){
+		listStorage[type + 1] = listStorage[type] + uint32_t((data.*resourceLists[type]).size());
+	}
+	const size_t total = listStorage.back();
+	columnStorage.resize(NumColumns * total);
+
+	// names point into data while the table is built, so the index stays valid as the table grows
+	std::unordered_map<std::string_view, uint32_t> interned;
+	size_t row = 0;
+	for (auto list : resourceLists){
+		for (const auto& resource : data.*list){
+			auto [it, inserted] = interned.try_emplace(resource.name, uint32_t(nameStorage.size()));
+			if (inserted){
+				nameStorage += resource.name;
+			}
+			const uint32_t values[NumColumns]{
+				resource.id, resource.type_id, resource.base_type_id, resource.set, resource.binding, resource.location, resource.samplerBinding,
+				it->second, uint32_t(resource.name.size())
+			};
+			for (size_t col = 0; col < NumColumns; col++){
+				columnStorage[col * total + row] = values[col];
+			}
+			row++;
+		}
+	}
+	nameStorage.shrink_to_fit();
+	computeDim = data.compute_dim;
+	bind();
+}
+
+CompactReflectData::CompactReflectData(const CompactReflectData& other) : ReflectionView(other), listStorage(other.listStorage), columnStorage(other.columnStorage), nameStorage(other.nameStorage){
+	bind();
+}
+
+CompactReflectData::CompactReflectData(CompactReflectData&& other) noexcept : ReflectionView(other), listStorage(other.listStorage), columnStorage(std::move(other.columnStorage)), nameStorage(std::move(other.nameStorage)){
+	bind();
+	other.listStorage = {};
+	other.bind();
+}
+
+CompactReflectData& CompactReflectData::operator=(const CompactReflectData& other){
+	if (this != &other){
+		ReflectionView::operator=(other);
+		listStorage = other.listStorage;
+		columnStorage = other.columnStorage;
+		nameStorage = other.nameStorage;
+		bind();
+	}
+	return *this;
+}
+
+CompactReflectData& CompactReflectData::operator=(CompactReflectData&& other) noexcept{
+	if (this != &other){
+		ReflectionView::operator=(other);
+		listStorage = other.listStorage;
+		columnStorage = std::move(other.columnStorage);
+		nameStorage = std::move(other.nameStorage);
+		bind();
+		other.listStorage = {};
+		other.bind();
+	}
+	return *this;
+}
+
+void CompactReflectData::bind(){
+	listStart = listStorage.data();
+	columns = columnStorage.data();
+	names = nameStorage;
+}
+
+size_t CompactReflectData::MemoryUsage() const{
+	return sizeof(*this) + columnStorage.capacity() * sizeof(columnStorage[0]) + (nameStorage.capacity() > std::string().capacity() ? nameStorage.capacity() : 0);
+}
@@ -0,0 +1,90 @@
+#include "CompileContext.hpp"
+#include "LockTiming.hpp"
+#include <glslang/Public/ShaderLang.h>
+#include <mutex>
+#include <stdexcept>
+#if ST_ENABLE_WGSL
+#include <tint/tint.h>
+#endif
+
+using namespace shadert;
+
+extern TBuiltInResource CreateDefaultTBuiltInResource();
+
+// process-wide library initialization, safe to race from any number of threads
+static std::once_flag glslangInitFlag;
+#if ST_ENABLE_WGSL
+static std::once_flag tintInitFlag;
+#endif
+
+CompileContext& CompileContext::ForThread(){
+	thread_local CompileContext context;
+	return context;
+}
+
+/**
+ Run a process-wide initializer once. Threads that arrive while another thread runs it count the wait in ThreadLockWait.
+ */
+template<typename fn_t>
+static void initializeOnce(std::once_flag& flag, fn_t&& fn){
+	bool ran = false;
+	const auto start = std::chrono::steady_clock::now();
+	std::call_once(flag, [&]{
+		fn();
+		ran = true;
+	});
+	if (!ran){
+		ThreadLockWait() += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+	}
+}
+
+CompileContext::CompileContext() : resources(CreateDefaultTBuiltInResource()){
+	initializeOnce(glslangInitFlag, []{
+		glslang::InitializeProcess();
+	});
+#if ST_ENABLE_WGSL
+	initializeOnce(tintInitFlag, []{
+		tint::Initialize();
+	});
+#endif
+	consumer = [](spv_message_level_t level, const char*, const spv_position_t&, const char* message){
+		switch(level){
+			case SPV_MSG_FATAL:
+			case SPV_MSG_INTERNAL_ERROR:
+			case SPV_MSG_ERROR:
+				throw std::runtime_error(message);
+			case SPV_MSG_WARNING:
+			case SPV_MSG_INFO:
+			case SPV_MSG_DEBUG:
+				break;
+		}
+	};
+}
+
+std::unique_ptr<spvtools::Optimizer> CompileContext::MakeOptimizer(spv_target_env env, OptimizationLevel level, const std::vector<std::string>& passes) const{
+	auto optimizer = std::make_unique<spvtools::Optimizer>(env);
+	optimizer->SetMessageConsumer(consumer);
+	switch (level){
+		case OptimizationLevel::Default:
+			optimizer->RegisterSizePasses();
+			optimizer->RegisterPerformancePasses();
+			optimizer->RegisterLegalizationPasses();
+			break;
+		case OptimizationLevel::Size:
+			optimizer->RegisterSizePasses();
+			break;
+		case OptimizationLevel::Performance:
+			optimizer->RegisterPerformancePasses();
+			break;
+		case OptimizationLevel::Custom:
+			for (const auto& pass : passes){
+				if (!optimizer->RegisterPassFromFlag(pass)){
+					throw std::runtime_error("Unknown optimizer pass: " + pass);
+				}
+			}
+			break;
+		case OptimizationLevel::None:
+			throw std::runtime_error("No optimizer for OptimizationLevel::None");
+	}
+	return optimizer;
+}
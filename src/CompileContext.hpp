@@ -0,0 +1,45 @@
+#pragma once
+#include <ShaderTranspiler.hpp>
+#include <glslang/Include/ResourceLimits.h>
+#include <spirv-tools/optimizer.hpp>
+#include <memory>
+
+namespace shadert{
+
+/**
+ The setup every compile needs that does not depend on the shader: glslang's resource limits and process-wide
+ library initialization. Building these is a fixed cost, so each thread keeps one context and reuses it for every
+ compile it runs.
+ */
+class CompileContext{
+public:
+	/**
+	 @return the context of the calling thread, created on first use
+	 */
+	static CompileContext& ForThread();
+
+	CompileContext(const CompileContext&) = delete;
+	CompileContext& operator=(const CompileContext&) = delete;
+
+	const TBuiltInResource& Resources() const{
+		return resources;
+	}
+
+	/**
+	 Create an optimizer for one module. Optimizers cannot be shared between modules: their passes keep state from
+	 the module they last ran on, and a reused optimizer leaves later modules unchanged.
+	 @param env the SPIR-V environment to optimize for
+	 @param level which passes to register. Must not be OptimizationLevel::None.
+	 @param passes the spirv-opt flags for OptimizationLevel::Custom
+	 @return the optimizer. Errors from it are thrown as std::runtime_error.
+	 */
+	std::unique_ptr<spvtools::Optimizer> MakeOptimizer(spv_target_env env, OptimizationLevel level, const std::vector<std::string>& passes) const;
+
+private:
+	CompileContext();
+
+	TBuiltInResource resources;
+	spvtools::MessageConsumer consumer;
+};
+
+}
@@ -0,0 +1,132 @@
+#include <ShaderTranspiler.hpp>
+#include "LockTiming.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+using namespace shadert;
+
+void CompileTrace::Record(Event event){
+	TimedLock lock(mtx);
+	events.push_back(std::move(event));
+}
+
+std::vector<CompileTrace::Event> CompileTrace::Events() const{
+	std::lock_guard lock(mtx);
+	return events;
+}
+
+void CompileTrace::Clear(){
+	std::lock_guard lock(mtx);
+	events.clear();
+}
+
+uint32_t CompileTrace::CurrentThread(){
+	static std::atomic<uint32_t> nextThread{1};
+	thread_local const uint32_t thread = nextThread++;
+	return thread;
+}
+
+static const char* targetName(TargetAPI api){
+	switch (api){
+		case TargetAPI::OpenGL_ES:
+			return "OpenGL ES";
+		case TargetAPI::OpenGL:
+			return "OpenGL";
+		case TargetAPI::Vulkan:
+			return "Vulkan";
+		case TargetAPI::HLSL:
+			return "HLSL";
+		case TargetAPI::WGSL:
+			return "WGSL";
+		case TargetAPI::DXIL:
+			return "DXIL";
+		case TargetAPI::Metal:
+			return "Metal";
+#ifdef __APPLE__
+		case TargetAPI::MetalBinary:
+			return "MetalBinary";
+#endif
+		default:
+			return "unknown";
+	}
+}
+
+/**
+ Append a string to JSON as a quoted, escaped string
+ */
+static void appendJSONString(std::string& json, std::string_view value){
+	json += '"';
+	for (char c : value){
+		switch (c){
+			case '"':
+				json += "\\\"";
+				break;
+			case '\\':
+				json += "\\\\";
+				break;
+			case '\n':
+				json += "\\n";
+				break;
+			default:
+				if (static_cast<unsigned char>(c) < 0x20){
+					char escaped[8];
+					std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+					json += escaped;
+				}
+				else{
+					json += c;
+				}
+				break;
+		}
+	}
+	json += '"';
+}
+
+std::string CompileTrace::ToChromeJSON() const{
+	const auto snapshot = Events();
+	std::chrono::steady_clock::time_point origin{};
+	if (!snapshot.empty()){
+		origin = std::min_element(snapshot.begin(), snapshot.end(), [](const Event& a, const Event& b){
+			return a.start < b.start;
+		})->start;
+	}
+	auto microseconds = [](std::chrono::steady_clock::duration duration){
+		return std::to_string(std::chrono::duration<double, std::micro>(duration).count());
+	};
+
+	// complete ("X") events, which stand for a begin and end pair
+	std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	for (size_t i = 0; i < snapshot.size(); i++){
+		const auto& event = snapshot[i];
+		if (i > 0){
+			json += ',';
+		}
+		json += "\n{\"name\":";
+		appendJSONString(json, event.name);
+		json += ",\"cat\":\"";
+		json += event.target ? "compile" : "stage";
+		json += "\",\"ph\":\"X\",\"pid\":1,\"tid\":" + std::to_string(event.threadId);
+		json += ",\"ts\":" + microseconds(event.start - origin) + ",\"dur\":" + microseconds(event.end - event.start);
+		json += ",\"args\":{\"shader\":";
+		appendJSONString(json, event.shader);
+		if (event.target){
+			json += ",\"target\":";
+			appendJSONString(json, targetName(*event.target));
+		}
+		json += "}}";
+	}
+	json += "\n]}\n";
+	return json;
+}
+
+void CompileTrace::WriteChromeJSON(const std::filesystem::path& path) const{
+	std::ofstream out(path, std::ios::binary);
+	if (!out){
+		throw std::runtime_error("failed to open trace file for writing: " + path.string());
+	}
+	out << ToChromeJSON();
+	if (!out){
+		throw std::runtime_error("failed to write trace file: " + path.string());
+	}
+}
@@ -0,0 +1,44 @@
+#include <ShaderTranspiler.hpp>
+#include <fstream>
+
+using namespace shadert;
+
+/**
+ Escape a path for the Makefile rule syntax, which Ninja also understands
+ */
+static std::string escapeMakePath(const std::filesystem::path& path){
+	std::string escaped;
+	for(char c : path.generic_string()){
+		switch(c){
+			case ' ':
+			case '#':
+				escaped += '\\';
+				break;
+			case '$':
+				escaped += '$';
+				break;
+		}
+		escaped += c;
+	}
+	return escaped;
+}
+
+std::string shadert::MakeDepfile(const std::filesystem::path& target, const CompileResult& result){
+	std::string depfile = escapeMakePath(target) + ":";
+	for(const auto& include : result.includes){
+		depfile += " \\\n  " + escapeMakePath(include.path);
+	}
+	depfile += "\n";
+	return depfile;
+}
+
+void shadert::WriteDepfile(const std::filesystem::path& depfile, const std::filesystem::path& target, const CompileResult& result){
+	std::ofstream file(depfile, std::ios::binary | std::ios::trunc);
+	if (!file){
+		throw std::runtime_error("failed to open depfile for writing: " + depfile.string());
+	}
+	file << MakeDepfile(target, result);
+	if (!file){
+		throw std::runtime_error("failed to write depfile: " + depfile.string());
+	}
+}
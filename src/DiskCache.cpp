@@ -0,0 +1,280 @@
+#include "DiskCache.hpp"
+#include "ByteStream.hpp"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <thread>
+
+using namespace shadert;
+namespace fs = std::filesystem;
+
+static constexpr uint32_t manifestMagic = 0x4d435453;	// 'STCM'
+static constexpr const char* manifestExtension = ".manifest";
+static constexpr const char* resultExtension = ".result";
+
+// a temporary file this old was left behind by a process that exited while writing
+static constexpr auto staleTemporaryAge = std::chrono::hours(1);
+
+enum class FileKind{
+	Entry,			// a manifest or a result
+	Temporary,		// an entry being written by writeAtomic
+	Other			// not ours
+};
+
+/**
+ @return what a file in a fan-out directory is, from its name
+ */
+static FileKind classify(const std::string& name){
+	const auto hasSuffix = [&](std::string_view suffix){
+		return name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0;
+	};
+	if (hasSuffix(manifestExtension) || hasSuffix(resultExtension)){
+		return FileKind::Entry;
+	}
+	for (const auto extension : {manifestExtension, resultExtension}){
+		if (name.find(std::string(extension) + ".tmp") != std::string::npos){
+			return FileKind::Temporary;
+		}
+	}
+	return FileKind::Other;
+}
+
+/**
+ @return true for the names of the subdirectories that entryPath fans out into: two lowercase hex digits
+ */
+static bool isFanOutDirectory(const std::string& name){
+	return name.size() == 2 && std::all_of(name.begin(), name.end(), [](char c){
+		return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f');
+	});
+}
+
+static std::optional<std::string> readFile(const fs::path& path){
+	std::ifstream file(path, std::ios::binary);
+	if (!file){
+		return std::nullopt;
+	}
+	std::ostringstream contents;
+	contents << file.rdbuf();
+	return std::move(contents).str();
+}
+
+/**
+ Read the includes listed in a manifest
+ @return the files, or nothing if one no longer exists or changed while it was read
+ */
+static std::optional<std::vector<IncludedFile>> readIncludes(const std::vector<std::string>& paths){
+	std::vector<IncludedFile> includes;
+	includes.reserve(paths.size());
+	for(const auto& path : paths){
+		std::error_code ec;
+		const auto time = fs::last_write_time(path, ec);
+		const auto size = ec ? 0 : fs::file_size(path, ec);
+		if (ec){
+			return std::nullopt;
+		}
+		auto file = std::make_shared<const IncludeFile>(path, time, size);
+		if (!file->Valid()){
+			return std::nullopt;
+		}
+		includes.push_back({path, std::move(file)});
+	}
+	return includes;
+}
+
+/**
+ Combine the input key with the contents of the includes. Store passes the contents that the compile read, so the key
+ matches the one Load computes only while the files are unchanged.
+ */
+static DiskCache::key_t resultKey(const DiskCache::key_t& inputKey, const std::vector<IncludedFile>& includes){
+	Sha256 hash;
+	hash.Update(inputKey.data(), inputKey.size());
+	for(const auto& include : includes){
+		hash.UpdateField(include.path);
+		hash.UpdateField(include.file->Contents());
+	}
+	return hash.Finish();
+}
+
+DiskCache::DiskCache(const fs::path& directory, uint64_t maxBytes) : directory(directory), maxBytes(maxBytes){
+	fs::create_directories(directory);
+	trim();
+}
+
+fs::path DiskCache::entryPath(const key_t& key, const char* extension) const{
+	auto name = Sha256::ToHex(key);
+	// fan out over subdirectories to keep directory listings short
+	return directory / name.substr(0, 2) / (name + extension);
+}
+
+std::optional<CompileResult> DiskCache::Load(const key_t& inputKey, std::vector<IncludedFile>* includesOut){
+	const auto manifestPath = entryPath(inputKey, manifestExtension);
+	auto manifest = readFile(manifestPath);
+	if (!manifest){
+		return std::nullopt;
+	}
+
+	ByteReader reader(*manifest);
+	uint32_t magic = 0;
+	uint64_t count = 0;
+	if (!reader.Value(magic) || magic != manifestMagic || !reader.Value(count)){
+		return std::nullopt;
+	}
+	std::vector<std::string> includes;
+	for(uint64_t i = 0; i < count; i++){
+		if (!reader.String(includes.emplace_back())){
+			return std::nullopt;
+		}
+	}
+
+	auto files = readIncludes(includes);
+	if (!files){
+		return std::nullopt;
+	}
+	const auto path = entryPath(resultKey(inputKey, *files), resultExtension);
+	std::optional<CompileResult> result;
+	try{
+		auto archive = ShaderArchive::Open(path);
+		if (archive.Size() == 1){
+			result = archive.At(0).ToCompileResult();
+		}
+	}
+	catch(const std::exception&){
+		// missing, truncated or from a different format version
+		return std::nullopt;
+	}
+	if (result){
+		// bump the entry to the front of the LRU order. Both files, or trim would evict the manifests of the most used
+		// entries first. Another process may have evicted them, which is fine.
+		const auto now = fs::file_time_type::clock::now();
+		std::error_code ec;
+		fs::last_write_time(path, now, ec);
+		fs::last_write_time(manifestPath, now, ec);
+		if (includesOut){
+			*includesOut = std::move(*files);
+		}
+	}
+	return result;
+}
+
+void DiskCache::Store(const key_t& inputKey, const std::vector<IncludedFile>& includes, const CompileResult& result){
+	const auto key = resultKey(inputKey, includes);
+
+	ByteWriter manifest;
+	manifest.Value(manifestMagic);
+	manifest.Value(uint64_t(includes.size()));
+	for(const auto& include : includes){
+		manifest.String(include.path);
+	}
+
+	// write the result before the manifest that points at it
+	ShaderArchiveWriter archive;
+	archive.Add(Sha256::ToHex(key), result);
+	writeAtomic(entryPath(key, resultExtension), archive.Finish());
+	writeAtomic(entryPath(inputKey, manifestExtension), manifest.Data());
+
+	if (maxBytes > 0 && approxSize > maxBytes){
+		trim();
+	}
+}
+
+void DiskCache::writeAtomic(const fs::path& path, const std::string& data){
+	static std::atomic<uint64_t> counter = 0;
+	thread_local std::mt19937_64 rng(std::random_device{}() ^ std::hash<std::thread::id>{}(std::this_thread::get_id()));
+
+	std::error_code ec;
+	fs::create_directories(path.parent_path(), ec);
+
+	// unique within this process (counter) and across processes (random)
+	auto tempPath = path;
+	tempPath += ".tmp" + std::to_string(rng()) + "_" + std::to_string(counter++);
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file){
+			return;
+		}
+		file.write(data.data(), data.size());
+		if (!file){
+			file.close();
+			fs::remove(tempPath, ec);
+			return;
+		}
+	}
+	fs::rename(tempPath, path, ec);
+	if (ec){
+		fs::remove(tempPath, ec);
+		return;
+	}
+	approxSize += data.size();
+}
+
+void DiskCache::trim(){
+	std::unique_lock lock(trimMtx, std::try_to_lock);
+	if (!lock.owns_lock()){
+		// someone else is already trimming
+		return;
+	}
+
+	struct Entry{
+		fs::path path;
+		fs::file_time_type time;
+		uint64_t size;
+	};
+	std::vector<Entry> entries;
+	uint64_t total = 0;
+	const auto staleTemporaries = fs::file_time_type::clock::now() - staleTemporaryAge;
+	// only look at our own files, in the fan-out subdirectories, so that other files in the directory are never deleted
+	std::error_code ec;
+	for(auto dir = fs::directory_iterator(directory, ec); !ec && dir != fs::directory_iterator(); dir.increment(ec)){
+		std::error_code dirError;
+		if (!isFanOutDirectory(dir->path().filename().string()) || !dir->is_directory(dirError)){
+			continue;
+		}
+		for(auto it = fs::directory_iterator(dir->path(), dirError); !dirError && it != fs::directory_iterator(); it.increment(dirError)){
+			// other processes sharing the directory may remove a file after it is listed, so skip it rather than stop
+			std::error_code statError;
+			if (!it->is_regular_file(statError)){
+				continue;
+			}
+			const auto kind = classify(it->path().filename().string());
+			if (kind == FileKind::Other){
+				continue;
+			}
+			Entry entry{it->path(), it->last_write_time(statError), 0};
+			if (!statError){
+				entry.size = it->file_size(statError);
+			}
+			if (statError){
+				continue;
+			}
+			if (kind == FileKind::Temporary){
+				// another process may still be writing it. Only remove it once it is clearly abandoned.
+				if (entry.time < staleTemporaries){
+					fs::remove(entry.path, statError);
+				}
+				continue;
+			}
+			total += entry.size;
+			entries.push_back(std::move(entry));
+		}
+	}
+
+	if (maxBytes > 0 && total > maxBytes){
+		// evict down to 90% so that we do not trim again on the very next store
+		const uint64_t target = maxBytes - maxBytes / 10;
+		std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b){
+			return a.time < b.time;
+		});
+		for(const auto& entry : entries){
+			if (total <= target){
+				break;
+			}
+			std::error_code removeError;
+			if (fs::remove(entry.path, removeError)){
+				total -= entry.size;
+			}
+		}
+	}
+	approxSize = total;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <ShaderTranspiler.hpp>
+#include "IncludeCache.hpp"
+#include "Sha256.hpp"
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace shadert{
+
+/**
+ Persistent, content-addressed store of CompileResults that can be shared by several processes.
+ 
+ Entries are found in two steps. The input key (source, options, target, stage, library versions) names a manifest
+ listing the files that the shader included. The current contents of those files are hashed together with the input key
+ to name the result. Editing any include therefore changes the result key without needing to parse the shader.
+ 
+ Files are written to a temporary name and renamed into place, so readers never observe a partial entry.
+ Least recently used entries are deleted once the directory grows past its size limit. Only the cache's own files count
+ toward the limit: files that it did not create are never deleted, and temporary files are removed only once they are
+ an hour old, since another process may still be writing them.
+ */
+class DiskCache{
+public:
+	using key_t = Sha256::digest_t;
+
+	/**
+	 @param directory where to store entries. Created if it does not exist.
+	 @param maxBytes size limit for the directory. 0 means unlimited.
+	 */
+	DiskCache(const std::filesystem::path& directory, uint64_t maxBytes);
+
+	/**
+	 Find a previously stored result
+	 @param inputKey the hash of everything that determines the output, except the include contents
+	 @param includes if not null, receives the files the shader included on a hit, with the contents that were hashed
+	 @return the result, or nothing on a miss
+	 */
+	std::optional<CompileResult> Load(const key_t& inputKey, std::vector<IncludedFile>* includes = nullptr);
+
+	/**
+	 Store a result
+	 @param inputKey the key that was passed to Load
+	 @param includes every file that was included while compiling the shader, with the contents the compile read
+	 @param result the result to store
+	 */
+	void Store(const key_t& inputKey, const std::vector<IncludedFile>& includes, const CompileResult& result);
+
+	const std::filesystem::path& Directory() const{
+		return directory;
+	}
+
+private:
+	std::filesystem::path entryPath(const key_t& key, const char* extension) const;
+	void writeAtomic(const std::filesystem::path& path, const std::string& data);
+	void trim();
+
+	std::filesystem::path directory;
+	uint64_t maxBytes;
+	std::atomic<uint64_t> approxSize = 0;		// only tracks our own writes between trims
+	std::mutex trimMtx;
+};
+
+}
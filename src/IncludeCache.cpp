@@ -0,0 +1,134 @@
+#include "IncludeCache.hpp"
+#include "LockTiming.hpp"
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+
+using namespace shadert;
+namespace fs = std::filesystem;
+
+/**
+ @return the directory that creating path would modify
+ */
+static fs::path directoryOf(const std::string& path){
+	auto parent = fs::path(path).parent_path();
+	return parent.empty() ? fs::path(".") : parent;
+}
+
+IncludeFile::IncludeFile(const std::string& path, fs::file_time_type time, uintmax_t size) : time(time), size(size){
+	// always copied, never memory-mapped: a mapping of a file that an editor or build step truncates while it is cached
+	// faults when read
+	std::ifstream file(path, std::ios::binary);
+	if (!file){
+		return;
+	}
+	std::ostringstream contents;
+	contents << file.rdbuf();
+	buffer = std::move(contents).str();
+	opened = true;
+}
+
+std::shared_ptr<const IncludeFile> IncludeFileCache::lookup(const std::string& path){
+	std::error_code ec;
+	{
+		TimedSharedLock lock(mtx);
+		auto it = entries.find(path);
+		if (it != entries.end()){
+			const auto& entry = it->second;
+			if (entry.file){
+				if (fs::last_write_time(path, ec) == entry.file->time && !ec && fs::file_size(path, ec) == entry.file->size && !ec){
+					return entry.file;
+				}
+			}
+			else{
+				auto dirTime = fs::last_write_time(directoryOf(path), ec);
+				if (!ec && dirTime == entry.dirTime){
+					return nullptr;
+				}
+			}
+		}
+	}
+
+	// missing or stale, go to the file system
+	Entry entry;
+	const bool isFile = fs::is_regular_file(path, ec);
+	if (isFile){
+		auto time = fs::last_write_time(path, ec);
+		auto size = ec ? 0 : fs::file_size(path, ec);
+		if (!ec){
+			auto file = std::make_shared<const IncludeFile>(path, time, size);
+			if (!file->Valid()){
+				// changed between the stat and the read. The compile gets what was read, but it cannot be revalidated
+				// later, so it is not kept.
+				return file->Opened() ? file : nullptr;
+			}
+			entry.file = std::move(file);
+		}
+	}
+	if (!entry.file){
+		if (isFile){
+			return nullptr;
+		}
+		entry.dirTime = fs::last_write_time(directoryOf(path), ec);
+		if (ec){
+			// we cannot validate this result later, so do not keep it
+			return nullptr;
+		}
+	}
+
+	auto file = entry.file;
+	TimedLock lock(mtx);
+	entries.insert_or_assign(path, std::move(entry));
+	return file;
+}
+
+std::shared_ptr<const IncludeFile> IncludeFileCache::Open(const std::string& path, memo_t& memo){
+	if (auto it = memo.find(path); it != memo.end()){
+		return it->second;
+	}
+	auto file = lookup(path);
+	memo.emplace(path, file);
+	return file;
+}
+
+glslang::TShader::Includer::IncludeResult* CachingIncluder::makeResult(const std::string& path, std::shared_ptr<const IncludeFile> file){
+	directoryStack.push_back(getDirectory(path));
+	includedFiles.insert(path);
+	served.emplace(path, file);
+	auto contents = file->Contents();
+	// userData keeps the file alive until glslang releases the include
+	return new IncludeResult(path, contents.data(), contents.size(), new std::shared_ptr<const IncludeFile>(std::move(file)));
+}
+
+glslang::TShader::Includer::IncludeResult* CachingIncluder::readLocalPath(const char* headerName, const char* includerName, int depth){
+	// first check for absolute paths:
+	if (auto file = cache.Open(headerName, memo)){
+		return makeResult(headerName, std::move(file));
+	}
+
+	// Discard popped include directories, and
+	// initialize when at parse-time first level.
+	directoryStack.resize(depth + externalLocalDirectoryCount);
+	if (depth == 1){
+		directoryStack.back() = getDirectory(includerName);
+	}
+
+	// Find a directory that works, using a reverse search of the include stack.
+	for (auto it = directoryStack.rbegin(); it != directoryStack.rend(); ++it){
+		std::string path = *it + '/' + headerName;
+		std::replace(path.begin(), path.end(), '\\', '/');
+		if (auto file = cache.Open(path, memo)){
+			return makeResult(path, std::move(file));
+		}
+	}
+
+	return nullptr;
+}
+
+void CachingIncluder::releaseInclude(IncludeResult* result){
+	if (result != nullptr){
+		delete static_cast<std::shared_ptr<const IncludeFile>*>(result->userData);
+		delete result;
+	}
+}
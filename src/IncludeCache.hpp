@@ -0,0 +1,117 @@
+#pragma once
+#include <StandAlone/DirStackFileIncluder.h>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace shadert{
+
+/**
+ The contents of an include file, read into memory
+ */
+class IncludeFile{
+public:
+	IncludeFile(const std::string& path, std::filesystem::file_time_type time, uintmax_t size);
+
+	IncludeFile(const IncludeFile&) = delete;
+	IncludeFile& operator=(const IncludeFile&) = delete;
+
+	std::string_view Contents() const{
+		return buffer;
+	}
+
+	/**
+	 @return true if the file could be read
+	 */
+	bool Opened() const{
+		return opened;
+	}
+
+	/**
+	 @return true if the contents are those of the file at time, so that it can be revalidated by its time and size
+	 */
+	bool Valid() const{
+		return opened && buffer.size() == size;
+	}
+
+	const std::filesystem::file_time_type time;
+	const uintmax_t size;
+
+private:
+	std::string buffer;
+	bool opened = false;
+};
+
+/**
+ A file that a compile included, with the contents that the compile read
+ */
+struct IncludedFile{
+	std::string path;		// absolute
+	std::shared_ptr<const IncludeFile> file;
+};
+
+/**
+ Thread-safe cache of include lookups and file contents, shared by every compile of a ShaderTranspiler.
+ Found files are revalidated against their modification time and size. Missing files are remembered together with
+ the modification time of the directory they would be in, since creating the file changes that time.
+ */
+class IncludeFileCache{
+public:
+	/**
+	 Per-compile memo, so that each path is validated at most once per compile
+	 */
+	using memo_t = std::unordered_map<std::string, std::shared_ptr<const IncludeFile>>;
+
+	/**
+	 Look up a file
+	 @param path the path to open
+	 @param memo the memo of the calling compile
+	 @return the file, or nullptr if it does not exist
+	 */
+	std::shared_ptr<const IncludeFile> Open(const std::string& path, memo_t& memo);
+
+private:
+	struct Entry{
+		std::shared_ptr<const IncludeFile> file;	// null for a missing file
+		std::filesystem::file_time_type dirTime;		// only used for missing files
+	};
+
+	std::shared_ptr<const IncludeFile> lookup(const std::string& path);
+
+	std::shared_mutex mtx;
+	std::unordered_map<std::string, Entry> entries;
+};
+
+/**
+ A DirStackFileIncluder that resolves and reads through an IncludeFileCache.
+ The search order is the same as DirStackFileIncluder.
+ */
+class CachingIncluder : public DirStackFileIncluder{
+public:
+	explicit CachingIncluder(IncludeFileCache& cache) : cache(cache){}
+
+	void releaseInclude(IncludeResult* result) override;
+
+	/**
+	 @return every file that was included, by the path it was included as
+	 */
+	const std::map<std::string, std::shared_ptr<const IncludeFile>>& ServedFiles() const{
+		return served;
+	}
+
+protected:
+	IncludeResult* readLocalPath(const char* headerName, const char* includerName, int depth) override;
+
+private:
+	IncludeResult* makeResult(const std::string& path, std::shared_ptr<const IncludeFile> file);
+
+	IncludeFileCache& cache;
+	IncludeFileCache::memo_t memo;
+	std::map<std::string, std::shared_ptr<const IncludeFile>> served;
+};
+
+}
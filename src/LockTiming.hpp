@@ -0,0 +1,71 @@
+#pragma once
+#include <chrono>
+#include <mutex>
+
+namespace shadert{
+
+/**
+ @return the time the calling thread has spent blocked on the library's own locks, since it started
+ */
+inline std::chrono::nanoseconds& ThreadLockWait(){
+	thread_local std::chrono::nanoseconds total{};
+	return total;
+}
+
+/**
+ Take a lock, charging the time spent blocked to ThreadLockWait when another thread holds it
+ @param tryLock attempts to take the lock without blocking
+ @param lock takes the lock, blocking
+ */
+template<typename try_t, typename lock_t>
+void lockTimed(try_t&& tryLock, lock_t&& lock){
+	if (tryLock()){
+		return;
+	}
+	const auto start = std::chrono::steady_clock::now();
+	lock();
+	ThreadLockWait() += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+}
+
+/**
+ std::lock_guard for the locks on the compile path. An uncontended lock costs a try_lock; only a contended one reads the
+ clock, so that CompileStats can report how long compiles waited on each other.
+ */
+template<typename mutex_t>
+class TimedLock{
+public:
+	explicit TimedLock(mutex_t& mtx) : mtx(mtx){
+		lockTimed([&]{ return mtx.try_lock(); }, [&]{ mtx.lock(); });
+	}
+	~TimedLock(){
+		mtx.unlock();
+	}
+
+	TimedLock(const TimedLock&) = delete;
+	TimedLock& operator=(const TimedLock&) = delete;
+
+private:
+	mutex_t& mtx;
+};
+
+/**
+ std::shared_lock counterpart of TimedLock
+ */
+template<typename mutex_t>
+class TimedSharedLock{
+public:
+	explicit TimedSharedLock(mutex_t& mtx) : mtx(mtx){
+		lockTimed([&]{ return mtx.try_lock_shared(); }, [&]{ mtx.lock_shared(); });
+	}
+	~TimedSharedLock(){
+		mtx.unlock_shared();
+	}
+
+	TimedSharedLock(const TimedSharedLock&) = delete;
+	TimedSharedLock& operator=(const TimedSharedLock&) = delete;
+
+private:
+	mutex_t& mtx;
+};
+
+}
@@ -0,0 +1,26 @@
+#include "MemoryCache.hpp"
+
+using namespace shadert;
+namespace fs = std::filesystem;
+
+std::optional<std::vector<IncludeStamp>> shadert::StampIncludes(const std::vector<IncludedFile>& includes){
+	std::vector<IncludeStamp> stamps;
+	stamps.reserve(includes.size());
+	for(const auto& include : includes){
+		if (!include.file->Valid()){
+			return std::nullopt;
+		}
+		stamps.push_back({include.path, include.file->time, include.file->size});
+	}
+	return stamps;
+}
+
+bool shadert::StampsValid(const std::vector<IncludeStamp>& stamps){
+	for(const auto& stamp : stamps){
+		std::error_code ec;
+		if (fs::last_write_time(stamp.path, ec) != stamp.time || ec || fs::file_size(stamp.path, ec) != stamp.size || ec){
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,182 @@
+#pragma once
+#include <ShaderTranspiler.hpp>
+#include "IncludeCache.hpp"
+#include "Sha256.hpp"
+#include "LockTiming.hpp"
+#include <array>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace shadert{
+
+/**
+ The modification time and size of an included file when a cache entry was made
+ */
+struct IncludeStamp{
+	std::string path;
+	std::filesystem::file_time_type time;
+	uintmax_t size = 0;
+};
+
+/**
+ Record the state of a set of includes when they were read. Stamping the files after the compile instead would tie an
+ entry to an edit that the compile never saw.
+ @return the stamps, or nothing if a file changed while it was being read
+ */
+std::optional<std::vector<IncludeStamp>> StampIncludes(const std::vector<IncludedFile>& includes);
+
+/**
+ @return true if none of the includes have changed since they were stamped
+ */
+bool StampsValid(const std::vector<IncludeStamp>& stamps);
+
+/**
+ A byte-bounded LRU map split into independently locked shards, so that concurrent compiles rarely contend.
+ Values are immutable and shared, so a hit only copies a pointer while the shard is locked. The byte budget is shared by
+ all shards, so one value may use all of it: eviction starts with the oldest entries of the value's own shard and moves
+ on to the other shards if that is not enough.
+ */
+template<typename T>
+class ShardedLRUCache{
+public:
+	using key_t = Sha256::digest_t;
+
+	explicit ShardedLRUCache(size_t maxBytes) : maxBytes(maxBytes){}
+
+	/**
+	 @return the value, or nullptr on a miss. Entries whose includes changed on disk are dropped.
+	 */
+	std::shared_ptr<const T> Find(const key_t& key){
+		auto& shard = shardFor(key);
+		std::shared_ptr<const T> value;
+		std::vector<IncludeStamp> includes;
+		{
+			TimedLock lock(shard.mtx);
+			auto it = shard.index.find(key);
+			if (it != shard.index.end()){
+				// move to the front of the LRU order
+				shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+				value = it->second->value;
+				includes = it->second->includes;
+			}
+		}
+		// check the file system without holding the lock
+		if (value && !StampsValid(includes)){
+			TimedLock lock(shard.mtx);
+			auto it = shard.index.find(key);
+			if (it != shard.index.end() && it->second->value == value){
+				eraseLocked(shard, it->second);
+			}
+			value = nullptr;
+		}
+		(value ? hits : misses)++;
+		return value;
+	}
+
+	/**
+	 Add or replace a value. Values larger than the whole budget are not stored, and are counted as rejected.
+	 @param bytes the approximate memory used by the value
+	 @param includes the files the value was derived from
+	 */
+	void Insert(const key_t& key, std::shared_ptr<const T> value, size_t bytes, std::vector<IncludeStamp> includes){
+		if (bytes > maxBytes){
+			rejected++;
+			return;
+		}
+		const size_t index = shardIndex(key);
+		{
+			auto& shard = shards[index];
+			TimedLock lock(shard.mtx);
+			if (auto it = shard.index.find(key); it != shard.index.end()){
+				eraseLocked(shard, it->second);
+			}
+			shard.lru.push_front({key, std::move(value), bytes, std::move(includes)});
+			shard.index.emplace(key, shard.lru.begin());
+			shard.bytes += bytes;
+			totalBytes += bytes;
+			while(totalBytes > maxBytes && shard.lru.size() > 1){
+				eraseLocked(shard, std::prev(shard.lru.end()));
+				evictions++;
+			}
+		}
+		// a large value can need room from the other shards, one lock at a time
+		for(size_t i = 1; i < numShards && totalBytes > maxBytes; i++){
+			auto& shard = shards[(index + i) % numShards];
+			TimedLock lock(shard.mtx);
+			while(totalBytes > maxBytes && !shard.lru.empty()){
+				eraseLocked(shard, std::prev(shard.lru.end()));
+				evictions++;
+			}
+		}
+	}
+
+	CacheCounters Counters(){
+		CacheCounters counters;
+		counters.hits = hits;
+		counters.misses = misses;
+		counters.evictions = evictions;
+		counters.rejected = rejected;
+		for(auto& shard : shards){
+			std::lock_guard lock(shard.mtx);
+			counters.entries += shard.lru.size();
+			counters.bytes += shard.bytes;
+		}
+		return counters;
+	}
+
+private:
+	static constexpr size_t numShards = 16;
+
+	struct Entry{
+		key_t key;
+		std::shared_ptr<const T> value;
+		size_t bytes;
+		std::vector<IncludeStamp> includes;
+	};
+
+	struct KeyHash{
+		size_t operator()(const key_t& key) const{
+			// the key is already a cryptographic hash
+			size_t value;
+			std::memcpy(&value, key.data(), sizeof(value));
+			return value;
+		}
+	};
+
+	struct Shard{
+		std::mutex mtx;
+		std::list<Entry> lru;
+		std::unordered_map<key_t, typename std::list<Entry>::iterator, KeyHash> index;
+		size_t bytes = 0;
+	};
+
+	static size_t shardIndex(const key_t& key){
+		return key.back() % numShards;
+	}
+
+	Shard& shardFor(const key_t& key){
+		return shards[shardIndex(key)];
+	}
+
+	void eraseLocked(Shard& shard, typename std::list<Entry>::iterator it){
+		shard.bytes -= it->bytes;
+		totalBytes -= it->bytes;
+		shard.index.erase(it->key);
+		shard.lru.erase(it);
+	}
+
+	std::array<Shard, numShards> shards;
+	size_t maxBytes;
+	std::atomic<size_t> totalBytes = 0;
+	std::atomic<uint64_t> hits = 0, misses = 0, evictions = 0, rejected = 0;
+};
+
+}
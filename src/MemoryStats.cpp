@@ -0,0 +1,194 @@
+#include "MemoryStats.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#if _WIN32
+#define NOMINMAX
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+using namespace shadert;
+
+namespace{
+
+/**
+ What the calling thread has allocated. Memory freed on another thread than the one that allocated it
+ counts against the thread that frees it.
+ */
+struct ThreadHeap{
+	uint64_t allocations;
+	uint64_t bytesAllocated;
+	int64_t liveBytes;
+	int64_t peakBytes;		// the highest liveBytes since the innermost probe started
+};
+
+thread_local ThreadHeap threadHeap{};
+
+/**
+ @return the peak resident set of the process so far, in KB
+ */
+int64_t peakResidentKB(){
+#if _WIN32
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))){
+		return 0;
+	}
+	return int64_t(counters.PeakWorkingSetSize / 1024);
+#else
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0){
+		return 0;
+	}
+#if __APPLE__
+	return int64_t(usage.ru_maxrss / 1024);		// bytes on Apple platforms
+#else
+	return int64_t(usage.ru_maxrss);
+#endif
+#endif
+}
+
+}
+
+MemoryProbe::MemoryProbe() : allocations(threadHeap.allocations), bytesAllocated(threadHeap.bytesAllocated), liveBytes(threadHeap.liveBytes),
+	outerPeak(threadHeap.peakBytes), residentKB(peakResidentKB()){
+	threadHeap.peakBytes = threadHeap.liveBytes;
+}
+
+MemoryUsage MemoryProbe::Finish(){
+	MemoryUsage usage;
+	usage.allocations = threadHeap.allocations - allocations;
+	usage.bytesAllocated = threadHeap.bytesAllocated - bytesAllocated;
+	usage.peakHeapGrowth = uint64_t(std::max<int64_t>(threadHeap.peakBytes - liveBytes, 0));
+	usage.peakResidentGrowthKB = peakResidentKB() - residentKB;
+	threadHeap.peakBytes = std::max(outerPeak, threadHeap.peakBytes);
+	return usage;
+}
+
+bool MemoryProbe::CountsAllocations(){
+	return ST_ENABLE_MEMORY_STATS;
+}
+
+#if ST_ENABLE_MEMORY_STATS
+// Every allocation is preceded by a header holding its size, so that frees can be counted without sized delete.
+// The header is as large as the alignment, which keeps the memory after it aligned.
+
+static void* countedAlloc(size_t size, size_t alignment) noexcept{
+	alignment = std::max(alignment, alignof(std::max_align_t));
+#if _WIN32
+	auto block = static_cast<char*>(_aligned_malloc(size + alignment, alignment));
+#else
+	auto block = static_cast<char*>(std::aligned_alloc(alignment, (size + alignment + alignment - 1) / alignment * alignment));
+#endif
+	if (!block){
+		return nullptr;
+	}
+	*reinterpret_cast<size_t*>(block) = size;
+	threadHeap.allocations++;
+	threadHeap.bytesAllocated += size;
+	threadHeap.liveBytes += int64_t(size);
+	threadHeap.peakBytes = std::max(threadHeap.peakBytes, threadHeap.liveBytes);
+	return block + alignment;
+}
+
+static void countedFree(void* memory, size_t alignment) noexcept{
+	if (!memory){
+		return;
+	}
+	alignment = std::max(alignment, alignof(std::max_align_t));
+	auto block = static_cast<char*>(memory) - alignment;
+	threadHeap.liveBytes -= int64_t(*reinterpret_cast<size_t*>(block));
+#if _WIN32
+	_aligned_free(block);
+#else
+	std::free(block);
+#endif
+}
+
+static void* countedNew(size_t size, size_t alignment){
+	while (true){
+		if (auto memory = countedAlloc(size, alignment)){
+			return memory;
+		}
+		auto handler = std::get_new_handler();
+		if (!handler){
+			throw std::bad_alloc();
+		}
+		handler();
+	}
+}
+
+static void* countedNewNoThrow(size_t size, size_t alignment) noexcept{
+	try{
+		return countedNew(size, alignment);
+	}
+	catch(...){
+		return nullptr;
+	}
+}
+
+void* operator new(size_t size){
+	return countedNew(size, 0);
+}
+void* operator new[](size_t size){
+	return countedNew(size, 0);
+}
+void* operator new(size_t size, const std::nothrow_t&) noexcept{
+	return countedNewNoThrow(size, 0);
+}
+void* operator new[](size_t size, const std::nothrow_t&) noexcept{
+	return countedNewNoThrow(size, 0);
+}
+void* operator new(size_t size, std::align_val_t alignment){
+	return countedNew(size, size_t(alignment));
+}
+void* operator new[](size_t size, std::align_val_t alignment){
+	return countedNew(size, size_t(alignment));
+}
+void* operator new(size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept{
+	return countedNewNoThrow(size, size_t(alignment));
+}
+void* operator new[](size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept{
+	return countedNewNoThrow(size, size_t(alignment));
+}
+
+void operator delete(void* memory) noexcept{
+	countedFree(memory, 0);
+}
+void operator delete[](void* memory) noexcept{
+	countedFree(memory, 0);
+}
+void operator delete(void* memory, size_t) noexcept{
+	countedFree(memory, 0);
+}
+void operator delete[](void* memory, size_t) noexcept{
+	countedFree(memory, 0);
+}
+void operator delete(void* memory, const std::nothrow_t&) noexcept{
+	countedFree(memory, 0);
+}
+void operator delete[](void* memory, const std::nothrow_t&) noexcept{
+	countedFree(memory, 0);
+}
+void operator delete(void* memory, std::align_val_t alignment) noexcept{
+	countedFree(memory, size_t(alignment));
+}
+void operator delete[](void* memory, std::align_val_t alignment) noexcept{
+	countedFree(memory, size_t(alignment));
+}
+void operator delete(void* memory, size_t, std::align_val_t alignment) noexcept{
+	countedFree(memory, size_t(alignment));
+}
+void operator delete[](void* memory, size_t, std::align_val_t alignment) noexcept{
+	countedFree(memory, size_t(alignment));
+}
+void operator delete(void* memory, std::align_val_t alignment, const std::nothrow_t&) noexcept{
+	countedFree(memory, size_t(alignment));
+}
+void operator delete[](void* memory, std::align_val_t alignment, const std::nothrow_t&) noexcept{
+	countedFree(memory, size_t(alignment));
+}
+#endif
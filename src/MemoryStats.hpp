@@ -0,0 +1,29 @@
+#pragma once
+#include <ShaderTranspiler.hpp>
+
+namespace shadert{
+
+/**
+ Measures the memory used between its construction and Finish. Probes on one thread must finish in the reverse
+ order of their construction.
+ */
+class MemoryProbe{
+public:
+	MemoryProbe();
+
+	/**
+	 @return the memory used since construction, including that of probes nested inside this one
+	 */
+	MemoryUsage Finish();
+
+	/**
+	 @return whether allocations are counted, which needs ST_ENABLE_MEMORY_STATS
+	 */
+	static bool CountsAllocations();
+
+private:
+	uint64_t allocations, bytesAllocated;
+	int64_t liveBytes, outerPeak, residentKB;
+};
+
+}
@@ -0,0 +1,108 @@
+#include "OptimizerReport.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <locale>
+#include <unordered_map>
+
+using namespace shadert;
+
+/**
+ Prints doubles with nanosecond precision whatever the stream's precision, always preceded by a space
+ so that values wider than their field stay separate
+ */
+struct FullPrecisionNumbers : public std::num_put<char>{
+	iter_type do_put(iter_type out, std::ios_base& str, char_type, double value) const override{
+		str.width(0);
+		char buffer[64];
+		const int length = std::snprintf(buffer, sizeof(buffer), " %.9f", value);
+		return std::copy(buffer, buffer + std::max(length, 0), out);
+	}
+};
+
+OptimizerTimeReport::OptimizerTimeReport(){
+	stream.imbue(std::locale(std::locale::classic(), new FullPrecisionNumbers));
+}
+
+std::vector<OptimizerPassStats> OptimizerTimeReport::Passes() const{
+	std::vector<OptimizerPassStats> passes;
+	std::istringstream lines(stream.str());
+	std::string line;
+	while (std::getline(lines, line)){
+		// name, CPU, wall, user, system, RSS delta, page fault delta. Figures that could not be measured read "Failed".
+		std::istringstream fields(line);
+		std::string name, cpu, wall, user, system, rss, faults;
+		if (!(fields >> name >> cpu >> wall >> user >> system >> rss >> faults)){
+			continue;
+		}
+		auto number = [](const std::string& field){
+			char* end = nullptr;
+			const double value = std::strtod(field.c_str(), &end);
+			return (end == field.c_str() || *end != '\0') ? -1.0 : value;
+		};
+		// the header line has no numbers in it
+		if (number(wall) < 0 && wall != "Failed"){
+			continue;
+		}
+		OptimizerPassStats pass;
+		pass.name = std::move(name);
+		pass.cpuSeconds = number(cpu);
+		pass.wallSeconds = number(wall);
+		pass.peakRssGrowthKB = int64_t(number(rss));
+		pass.pageFaults = int64_t(number(faults));
+		passes.push_back(std::move(pass));
+	}
+	return passes;
+}
+
+/**
+ Add the passes of one compile to a running total
+ @param index the position of each pass name in totals
+ */
+static void accumulatePasses(std::vector<OptimizerPassStats>& totals, std::unordered_map<std::string, size_t>& index, const std::vector<OptimizerPassStats>& passes){
+	for (const auto& pass : passes){
+		auto [it, inserted] = index.try_emplace(pass.name, totals.size());
+		if (inserted){
+			totals.push_back(pass);
+			continue;
+		}
+		auto& total = totals[it->second];
+		auto add = [](auto& sum, auto value){
+			// -1 marks a figure that could not be measured, which poisons the sum
+			sum = (sum < 0 || value < 0) ? -1 : sum + value;
+		};
+		total.runs += pass.runs;
+		add(total.wallSeconds, pass.wallSeconds);
+		add(total.cpuSeconds, pass.cpuSeconds);
+		add(total.peakRssGrowthKB, pass.peakRssGrowthKB);
+		add(total.pageFaults, pass.pageFaults);
+	}
+}
+
+static void sortByWallTime(std::vector<OptimizerPassStats>& totals){
+	std::stable_sort(totals.begin(), totals.end(), [](const auto& a, const auto& b){
+		return a.wallSeconds > b.wallSeconds;
+	});
+}
+
+std::vector<OptimizerPassStats> shadert::AggregateOptimizerPasses(const std::vector<BatchResult>& results){
+	std::vector<OptimizerPassStats> totals;
+	std::unordered_map<std::string, size_t> index;
+	for (const auto& result : results){
+		if (result.succeeded){
+			accumulatePasses(totals, index, result.result.optimizerPasses);
+		}
+	}
+	sortByWallTime(totals);
+	return totals;
+}
+
+std::vector<OptimizerPassStats> shadert::AggregateOptimizerPasses(const std::vector<CompileResult>& results){
+	std::vector<OptimizerPassStats> totals;
+	std::unordered_map<std::string, size_t> index;
+	for (const auto& result : results){
+		accumulatePasses(totals, index, result.optimizerPasses);
+	}
+	sortByWallTime(totals);
+	return totals;
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <ShaderTranspiler.hpp>
+#include <sstream>
+
+namespace shadert{
+
+/**
+ Receives the per-pass report that spvtools::Optimizer::SetTimeReport writes, and turns it into OptimizerPassStats.
+ The report normally rounds times to hundredths of a second, so the stream prints them at full precision instead.
+ */
+class OptimizerTimeReport{
+public:
+	OptimizerTimeReport();
+
+	/**
+	 @return the stream to pass to SetTimeReport
+	 */
+	std::ostream* Stream(){
+		return &stream;
+	}
+
+	/**
+	 @return one entry per pass that ran, in order
+	 */
+	std::vector<OptimizerPassStats> Passes() const;
+
+private:
+	std::ostringstream stream;
+};
+
+}
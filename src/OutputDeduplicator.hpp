@@ -0,0 +1,91 @@
+#pragma once
+#include <ShaderTranspiler.hpp>
+#include "Sha256.hpp"
+#include "LockTiming.hpp"
+#include <cstring>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+namespace shadert{
+
+/**
+ Shares backend output between the jobs of one batch whose backend input is identical.
+ The first job to reach a key runs the backend; the others wait for it and share its output. The text and binary
+ buffers are shared rather than copied, so duplicates cost only their reflection data.
+ */
+class OutputDeduplicator{
+public:
+	using key_t = Sha256::digest_t;
+
+	/**
+	 Produce the output for a key, running fn only if no other job has produced it
+	 @param key the hash of the backend input
+	 @param jobId identifies the calling job in its batch
+	 @param fn produces the output
+	 */
+	template<typename fn_t>
+	IMResult Run(const key_t& key, uint64_t jobId, fn_t&& fn){
+		std::promise<IMResult> promise;
+		std::shared_future<IMResult> future;
+		uint64_t owner = jobId;
+		{
+			TimedLock lock(mtx);
+			auto it = outputs.find(key);
+			if (it == outputs.end()){
+				future = promise.get_future().share();
+				outputs.emplace(key, Entry{future, jobId});
+			}
+			else{
+				future = it->second.output;
+				owner = it->second.owner;
+			}
+		}
+		if (owner == jobId){
+			try{
+				promise.set_value(fn());
+			}
+			catch(...){
+				promise.set_exception(std::current_exception());
+			}
+			return future.get();
+		}
+		// rethrows if the owner failed, in which case this job did not reuse anything
+		auto output = future.get();
+		TimedLock lock(mtx);
+		duplicates.insert_or_assign(jobId, owner);
+		return output;
+	}
+
+	/**
+	 @return the job whose output was reused by jobId, or nothing if jobId ran its own backend
+	 */
+	std::optional<uint64_t> DuplicateOf(uint64_t jobId){
+		std::lock_guard lock(mtx);
+		if (auto it = duplicates.find(jobId); it != duplicates.end()){
+			return it->second;
+		}
+		return std::nullopt;
+	}
+
+private:
+	struct KeyHash{
+		size_t operator()(const key_t& key) const{
+			size_t value;
+			std::memcpy(&value, key.data(), sizeof(value));
+			return value;
+		}
+	};
+
+	struct Entry{
+		std::shared_future<IMResult> output;
+		uint64_t owner;
+	};
+
+	std::mutex mtx;
+	std::unordered_map<key_t, Entry, KeyHash> outputs;
+	std::unordered_map<uint64_t, uint64_t> duplicates;
+};
+
+}
@@ -0,0 +1,70 @@
+#include "PipelineContext.hpp"
+#include <algorithm>
+
+using namespace shadert;
+
+const char* shadert::StageName(CompileStage stage){
+	switch (stage){
+		case CompileStage::Parse:
+			return "parse";
+		case CompileStage::Link:
+			return "link";
+		case CompileStage::SpirvGeneration:
+			return "SPIR-V generation";
+		case CompileStage::GlslReflection:
+			return "GLSL reflection";
+		case CompileStage::Optimization:
+			return "optimization";
+		case CompileStage::CrossCompile:
+			return "cross compile";
+		case CompileStage::Reflection:
+			return "reflection";
+		case CompileStage::BinaryCompile:
+			return "binary compile";
+		default:
+			return "unknown";
+	}
+}
+
+StageScope::StageScope(const PipelineContext& ctx, CompileStage stage) : ctx(ctx), parent(ctx.activeStage), stage(stage){
+	if (!ctx.stats && !ctx.trace){
+		return;
+	}
+	ctx.activeStage = this;
+	if (ctx.stats){
+		memory.emplace();
+	}
+	start = clock::now();
+}
+
+StageScope::~StageScope(){
+	if (!ctx.stats && !ctx.trace){
+		return;
+	}
+	const auto end = clock::now();
+	const auto elapsed = end - start;
+	if (ctx.trace){
+		ctx.trace->Record({StageName(stage), ctx.shaderName ? *ctx.shaderName : std::string(), std::nullopt, CompileTrace::CurrentThread(), start, end});
+	}
+	if (parent){
+		parent->nested += elapsed;
+	}
+	ctx.activeStage = parent;
+	if (!ctx.stats){
+		return;
+	}
+
+	const auto used = memory->Finish();
+	ctx.stats->stageDurations[size_t(stage)] += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed - nested);
+
+	auto& total = ctx.stats->stageMemory[size_t(stage)];
+	total.allocations += used.allocations - nestedAllocations;
+	total.bytesAllocated += used.bytesAllocated - nestedBytes;
+	total.peakHeapGrowth = std::max(total.peakHeapGrowth, used.peakHeapGrowth);
+	total.peakResidentGrowthKB = std::max(total.peakResidentGrowthKB, used.peakResidentGrowthKB);
+
+	if (parent){
+		parent->nestedAllocations += used.allocations;
+		parent->nestedBytes += used.bytesAllocated;
+	}
+}
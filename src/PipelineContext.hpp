@@ -0,0 +1,64 @@
+#pragma once
+#include <ShaderTranspiler.hpp>
+#include "CompileContext.hpp"
+#include "MemoryStats.hpp"
+#include <chrono>
+#include <optional>
+
+namespace shadert{
+
+class OutputDeduplicator;
+class StageScope;
+struct PushConstantMember;
+
+/**
+ State carried through one run of the compile pipeline
+ */
+struct PipelineContext {
+	CompileContext& compiler = CompileContext::ForThread();		// the setup reused by every compile on this thread
+	const std::atomic<bool>* cancelled = nullptr;
+	OutputDeduplicator* dedup = nullptr;		// set when compiling as part of a batch
+	uint64_t jobId = 0;						// identifies this compile in dedup
+	std::vector<OptimizerPassStats>* optimizerPasses = nullptr;	// receives the optimizer's per-pass report, if requested
+	CompileStats* stats = nullptr;				// receives stage timings, if requested
+	CompileTrace* trace = nullptr;				// receives an event per stage, if tracing
+	const std::string* shaderName = nullptr;	// the name of the shader in trace events
+	const std::vector<PushConstantMember>* pushConstants = nullptr;	// the front end's push constant members, for layout errors
+	mutable StageScope* activeStage = nullptr;	// the innermost stage being timed
+
+	/**
+	 Stop the pipeline if the caller has cancelled the compile
+	 @param stage the stage that just completed
+	 */
+	void checkpoint(const char* stage) const {
+		if (cancelled != nullptr && cancelled->load(std::memory_order_relaxed)) {
+			throw CompileCancelled(std::string("Compile cancelled after ") + stage);
+		}
+	}
+};
+
+/**
+ Measures a pipeline stage for CompileStats and CompileTrace, from construction until destruction. In CompileStats, time
+ and allocations in a stage that starts inside this one are charged to that stage only.
+ */
+class StageScope{
+public:
+	StageScope(const PipelineContext& ctx, CompileStage stage);
+	~StageScope();
+
+	StageScope(const StageScope&) = delete;
+	StageScope& operator=(const StageScope&) = delete;
+
+private:
+	using clock = std::chrono::steady_clock;
+
+	const PipelineContext& ctx;
+	StageScope* parent;
+	CompileStage stage;
+	clock::time_point start;
+	clock::duration nested{};		// time spent in stages inside this one
+	std::optional<MemoryProbe> memory;
+	uint64_t nestedAllocations = 0, nestedBytes = 0;
+};
+
+}
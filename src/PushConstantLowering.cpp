@@ -0,0 +1,378 @@
+#include "PushConstantLowering.hpp"
+#include <spirv.hpp>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+using namespace shadert;
+
+namespace {
+
+[[noreturn]] void invalidModule(const char* reason){
+	throw std::runtime_error(std::string("Push constant lowering failed: ") + reason);
+}
+
+/**
+ @return true if op may appear before the annotations of a module: capabilities, extensions, entry points and debug info
+ */
+bool precedesAnnotations(uint32_t op){
+	switch (op){
+		case spv::OpCapability:
+		case spv::OpExtension:
+		case spv::OpExtInstImport:
+		case spv::OpMemoryModel:
+		case spv::OpEntryPoint:
+		case spv::OpExecutionMode:
+		case spv::OpExecutionModeId:
+		case spv::OpString:
+		case spv::OpSource:
+		case spv::OpSourceContinued:
+		case spv::OpSourceExtension:
+		case spv::OpName:
+		case spv::OpMemberName:
+		case spv::OpModuleProcessed:
+		case spv::OpDecorate:
+		case spv::OpMemberDecorate:
+		case spv::OpDecorationGroup:
+		case spv::OpGroupDecorate:
+		case spv::OpGroupMemberDecorate:
+		case spv::OpDecorateId:
+		case spv::OpDecorateString:
+		case spv::OpMemberDecorateString:
+			return true;
+		default:
+			return false;
+	}
+}
+
+/**
+ The types, names and layout decorations of a module, for checking that a push constant block is a valid uniform buffer.
+ Push constants use the std430 rules, but uniform buffers need the std140 ones: arrays, matrices and structs aligned to
+ 16 bytes, and array and matrix strides that are multiples of 16.
+ */
+class BlockLayout{
+public:
+	void Record(const uint32_t* inst, uint32_t op, uint32_t count){
+		switch (op){
+			case spv::OpName:
+				names[inst[1]] = literal(inst + 2, count - 2);
+				break;
+			case spv::OpMemberName:
+				memberNames[key(inst[1], inst[2])] = literal(inst + 3, count - 3);
+				break;
+			case spv::OpDecorate:
+				if (count >= 4 && inst[2] == spv::DecorationArrayStride){
+					arrayStrides[inst[1]] = inst[3];
+				}
+				break;
+			case spv::OpMemberDecorate:
+				if (count >= 5 && inst[3] == spv::DecorationOffset){
+					offsets[key(inst[1], inst[2])] = inst[4];
+				}
+				else if (count >= 5 && inst[3] == spv::DecorationMatrixStride){
+					matrixStrides[key(inst[1], inst[2])] = inst[4];
+				}
+				break;
+			case spv::OpTypeInt:
+			case spv::OpTypeFloat:
+				types[inst[1]] = {op, 0, inst[2] / 8};
+				break;
+			case spv::OpTypeVector:
+			case spv::OpTypeMatrix:
+			case spv::OpTypeArray:
+				types[inst[1]] = {op, inst[2], inst[3]};
+				break;
+			case spv::OpTypeStruct:
+				types[inst[1]] = {op};
+				structMembers[inst[1]].assign(inst + 2, inst + count);
+				break;
+			case spv::OpTypePointer:
+				types[inst[1]] = {op, inst[3]};
+				break;
+			case spv::OpConstant:
+				if (count >= 4){
+					constants[inst[2]] = inst[3];
+				}
+				break;
+			default:
+				break;
+		}
+	}
+
+	/**
+	 Throw if the block pointed to by a push constant variable's type does not follow the uniform buffer layout rules
+	 @param pointerType the type of the variable
+	 @param reflected the front end's names for the members, or null
+	 */
+	void Validate(uint32_t pointerType, const std::vector<PushConstantMember>* reflected){
+		frontEnd = reflected;
+		auto it = types.find(pointerType);
+		if (it != types.end() && it->second.op == spv::OpTypePointer){
+			validateStruct(it->second.element, blockName(it->second.element), 0, 1);
+		}
+	}
+
+private:
+	struct Type{
+		uint32_t op = 0;
+		uint32_t element = 0;		// component, column, array element or pointee type
+		uint32_t count = 0;			// vector components, matrix columns, the array length id, or bytes for scalars
+	};
+
+	static uint64_t key(uint32_t id, uint32_t member){
+		return uint64_t(id) << 32 | member;
+	}
+
+	static std::string literal(const uint32_t* words, uint32_t count){
+		const auto bytes = reinterpret_cast<const char*>(words);
+		return std::string(bytes, strnlen(bytes, count * sizeof(uint32_t)));
+	}
+
+	/**
+	 @return the dot-separated parts of a reflected name, without array subscripts
+	 */
+	static std::vector<std::string> nameParts(const std::string& name){
+		std::vector<std::string> parts;
+		for (size_t start = 0; start <= name.size();){
+			const auto end = std::min(name.find('.', start), name.size());
+			auto part = name.substr(start, end - start);
+			part.resize(std::min(part.size(), part.find('[')));
+			parts.push_back(std::move(part));
+			start = end + 1;
+		}
+		return parts;
+	}
+
+	/**
+	 @return the name of a block, or an empty string if neither the module nor the front end has one
+	 */
+	std::string blockName(uint32_t structType) const{
+		if (auto it = names.find(structType); it != names.end() && !it->second.empty()){
+			return it->second;
+		}
+		if (frontEnd && !frontEnd->empty()){
+			return nameParts(frontEnd->front().name).front();
+		}
+		return {};
+	}
+
+	/**
+	 Name a member for an error. Modules compiled without debug info have no names, so the front end's reflection is
+	 searched for a member inside the same bytes, and the member index is the last resort.
+	 @param parent the name of the struct the member is in
+	 @param offset the member's offset from the start of the block
+	 @param depth how many structs deep the member is. Members of the block are at depth 1.
+	 */
+	std::string memberName(const std::string& parent, uint32_t structType, uint32_t member, uint64_t offset, size_t depth) const{
+		const auto prefix = parent.empty() ? parent : parent + ".";
+		if (auto it = memberNames.find(key(structType, member)); it != memberNames.end() && !it->second.empty()){
+			return prefix + it->second;
+		}
+		if (frontEnd){
+			const uint64_t end = offset + std::max<uint64_t>(memberSize(structType, member, structMembers.at(structType)[member]), 1);
+			for (const auto& reflected : *frontEnd){
+				auto parts = nameParts(reflected.name);
+				if (reflected.offset >= offset && reflected.offset < end && parts.size() > depth){
+					std::string name = parts[0];
+					for (size_t i = 1; i <= depth; i++){
+						name += "." + parts[i];
+					}
+					return name;
+				}
+			}
+		}
+		return prefix + std::to_string(member);
+	}
+
+	uint32_t find(const std::unordered_map<uint64_t, uint32_t>& map, uint64_t id) const{
+		auto it = map.find(id);
+		return it == map.end() ? 0 : it->second;
+	}
+
+	uint32_t find(const std::unordered_map<uint32_t, uint32_t>& map, uint32_t id) const{
+		auto it = map.find(id);
+		return it == map.end() ? 0 : it->second;
+	}
+
+	/**
+	 @return the bytes used by a member of a struct, or 0 if unknown
+	 */
+	uint64_t memberSize(uint32_t structType, uint32_t member, uint32_t type) const{
+		auto it = types.find(type);
+		if (it == types.end()){
+			return 0;
+		}
+		const auto& info = it->second;
+		switch (info.op){
+			case spv::OpTypeInt:
+			case spv::OpTypeFloat:
+				return info.count;
+			case spv::OpTypeVector:
+				return info.count * memberSize(structType, member, info.element);
+			case spv::OpTypeMatrix:
+				return uint64_t(info.count) * find(matrixStrides, key(structType, member));
+			case spv::OpTypeArray:
+				return uint64_t(find(constants, info.count)) * find(arrayStrides, type);
+			case spv::OpTypeStruct:
+				return structSize(type);
+			default:
+				return 0;
+		}
+	}
+
+	uint64_t structSize(uint32_t structType) const{
+		uint64_t size = 0;
+		const auto& members = structMembers.at(structType);
+		for (uint32_t member = 0; member < members.size(); member++){
+			size = std::max(size, find(offsets, key(structType, member)) + memberSize(structType, member, members[member]));
+		}
+		return size;
+	}
+
+	[[noreturn]] static void layoutError(const std::string& name, uint32_t member, uint64_t offset, const std::string& reason){
+		throw std::runtime_error("Push constant member " + name + " (member " + std::to_string(member) + " at byte offset " + std::to_string(offset)
+			+ ") " + reason + ". Push constants become a uniform buffer for this target, "
+			"which needs std140 alignment: array and matrix strides must be multiples of 16 bytes, and arrays, matrices and structs must "
+			"start on a multiple of 16.");
+	}
+
+	/**
+	 @param path the name of the struct
+	 @param base the offset of the struct from the start of the block
+	 @param depth the depth of the struct's members, 1 for the block's own
+	 */
+	void validateStruct(uint32_t structType, const std::string& path, uint64_t base, size_t depth){
+		if (!structMembers.contains(structType) || !validated.insert(structType).second){
+			return;
+		}
+		const auto& members = structMembers.at(structType);
+		std::vector<uint32_t> order(members.size());
+		for (uint32_t member = 0; member < members.size(); member++){
+			order[member] = member;
+		}
+		std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b){
+			return find(offsets, key(structType, a)) < find(offsets, key(structType, b));
+		});
+
+		for (size_t i = 0; i < order.size(); i++){
+			const uint32_t member = order[i];
+			const uint32_t offset = find(offsets, key(structType, member));
+			const auto name = memberName(path, structType, member, base + offset, depth);
+			const auto fail = [&](const std::string& reason){
+				layoutError(name, member, base + offset, reason);
+			};
+
+			// look through arrays to the element type
+			uint32_t type = members[member];
+			bool aggregate = false;
+			for (auto it = types.find(type); it != types.end() && it->second.op == spv::OpTypeArray; it = types.find(type)){
+				if (const auto stride = find(arrayStrides, type); stride % 16 != 0){
+					fail("is an array with a stride of " + std::to_string(stride) + " bytes");
+				}
+				aggregate = true;
+				type = it->second.element;
+			}
+			// the stride of a matrix, or of the matrices in an array, is decorated on the member
+			if (auto it = types.find(type); it != types.end() && it->second.op == spv::OpTypeMatrix){
+				if (const auto stride = find(matrixStrides, key(structType, member)); stride % 16 != 0){
+					fail("is a matrix with a stride of " + std::to_string(stride) + " bytes");
+				}
+				aggregate = true;
+			}
+			const bool isStruct = structMembers.contains(type);
+			aggregate |= isStruct;
+			if (!aggregate){
+				continue;
+			}
+			if (offset % 16 != 0){
+				fail("is an array, matrix or struct that does not start on a multiple of 16");
+			}
+			// the member after a struct or array starts at the next multiple of 16 past its end
+			const uint64_t end = offset + memberSize(structType, member, members[member]);
+			if (i + 1 < order.size()){
+				const uint32_t nextMember = order[i + 1];
+				const uint32_t next = find(offsets, key(structType, nextMember));
+				if (next < (end + 15) / 16 * 16){
+					layoutError(memberName(path, structType, nextMember, base + next, depth), nextMember, base + next, "is inside the padding after " + name);
+				}
+			}
+			if (isStruct){
+				validateStruct(type, name, base + offset, depth + 1);
+			}
+		}
+	}
+
+	std::unordered_map<uint32_t, std::string> names;
+	std::unordered_map<uint64_t, std::string> memberNames;
+	std::unordered_map<uint32_t, Type> types;
+	std::unordered_map<uint32_t, std::vector<uint32_t>> structMembers;
+	std::unordered_map<uint64_t, uint32_t> offsets, matrixStrides;
+	std::unordered_map<uint32_t, uint32_t> arrayStrides, constants;
+	std::unordered_set<uint32_t> validated;
+	const std::vector<PushConstantMember>* frontEnd = nullptr;
+};
+
+}
+
+spirvbytes shadert::LowerPushConstants(const spirvbytes& spirv, uint32_t set, uint32_t binding, const std::vector<PushConstantMember>* members){
+	constexpr size_t headerWords = 5;
+	if (spirv.size() < headerWords || spirv[0] != spv::MagicNumber){
+		invalidModule("not a SPIR-V module");
+	}
+
+	spirvbytes lowered(spirv);
+	BlockLayout layout;
+	std::vector<uint32_t> variables, variableTypes;
+	size_t annotationsEnd = 0;
+	for (size_t i = headerWords; i < lowered.size();){
+		const uint32_t op = lowered[i] & spv::OpCodeMask;
+		const uint32_t count = lowered[i] >> spv::WordCountShift;
+		if (count == 0 || i + count > lowered.size()){
+			invalidModule("truncated instruction");
+		}
+		if (annotationsEnd == 0 && !precedesAnnotations(op)){
+			annotationsEnd = i;
+		}
+		layout.Record(&lowered[i], op, count);
+		// the storage class operand of pointer types and variables
+		size_t storage = 0;
+		if (op == spv::OpTypePointer || op == spv::OpTypeForwardPointer){
+			storage = i + 2;
+		}
+		else if (op == spv::OpVariable){
+			storage = i + 3;
+		}
+		else if (op == spv::OpFunction){
+			// every push constant is declared before the first function
+			break;
+		}
+		if (storage != 0 && storage < i + count && lowered[storage] == spv::StorageClassPushConstant){
+			lowered[storage] = spv::StorageClassUniform;
+			if (op == spv::OpVariable){
+				variableTypes.push_back(lowered[i + 1]);
+				variables.push_back(lowered[i + 2]);
+			}
+		}
+		i += count;
+	}
+	if (variables.empty()){
+		return lowered;
+	}
+	for (auto type : variableTypes){
+		layout.Validate(type, members);
+	}
+
+	// uniform buffers need a descriptor set and binding, which go at the end of the annotations
+	std::vector<uint32_t> decorations;
+	decorations.reserve(variables.size() * 8);
+	for (auto variable : variables){
+		for (const auto& [decoration, value] : {std::pair{spv::DecorationDescriptorSet, set}, std::pair{spv::DecorationBinding, binding++}}){
+			decorations.insert(decorations.end(), {4u << spv::WordCountShift | spv::OpDecorate, variable, uint32_t(decoration), value});
+		}
+	}
+	lowered.insert(lowered.begin() + annotationsEnd, decorations.begin(), decorations.end());
+	return lowered;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <ShaderTranspiler.hpp>
+
+namespace shadert{
+
+/**
+ A push constant block member as the front end reflected it, for naming members in layout errors
+ */
+struct PushConstantMember{
+	std::string name;		// including the block name, such as Constants.light.power
+	uint32_t offset;		// from the start of the block
+};
+
+/**
+ Turn the push constant blocks of a SPIR-V module into uniform buffers, for targets that do not have push constants.
+ The block layout is kept as-is, so it must already follow the uniform buffer (std140) rules for arrays, matrices and
+ structs.
+ @param spirv the module
+ @param set the descriptor set of the uniform buffers
+ @param binding the binding of the first uniform buffer. Further blocks take the bindings after it.
+ @param members the front end's reflection of the push constant members, or null. Modules without debug info have no
+ names, so errors use these to name the member.
+ @return the lowered module, or a copy of spirv if it has no push constants. Throws std::runtime_error giving the name,
+ index and byte offset of the member if a block does not have a valid uniform buffer layout.
+ */
+spirvbytes LowerPushConstants(const spirvbytes& spirv, uint32_t set, uint32_t binding, const std::vector<PushConstantMember>* members = nullptr);
+
+}
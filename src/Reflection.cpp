@@ -0,0 +1,332 @@
+#include "Reflection.hpp"
+#include <spirv.hpp>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+
+using namespace shadert;
+
+namespace {
+
+constexpr uint32_t unassigned = ReflectData::Resource::Unassigned;
+
+/**
+ A type as SPIRV-Cross sees it: pointers and arrays take on the type they wrap, so self names the innermost type
+ */
+struct TypeInfo{
+	spv::Op op = spv::OpNop;
+	uint32_t self = 0;
+	bool pointer = false;
+	spv::StorageClass storage = spv::StorageClassMax;
+	spv::Dim dim = spv::DimMax;
+	uint32_t sampled = 0;
+};
+
+/**
+ Everything the walk needs to remember about one id
+ */
+struct IdInfo{
+	TypeInfo type;
+	std::string_view name;
+	uint32_t set = unassigned, binding = unassigned, location = unassigned;
+	uint32_t constant = 0;
+	bool block = false, bufferBlock = false, builtin = false, builtinMember = false;
+	bool inInterface = false, ssboType = false;
+};
+
+std::string_view literalString(const uint32_t* words, uint32_t count){
+	auto chars = reinterpret_cast<const char*>(words);
+	return {chars, strnlen(chars, count * sizeof(uint32_t))};
+}
+
+[[noreturn]] void invalidModule(const char* reason){
+	throw std::runtime_error(std::string("SPIRV reflection capture failed: ") + reason);
+}
+
+}
+
+ReflectData shadert::ReflectSPIRV(const spirvbytes& spirv){
+	constexpr size_t headerWords = 5;
+	if (spirv.size() < headerWords || spirv[0] != spv::MagicNumber){
+		invalidModule("not a SPIR-V module");
+	}
+	const uint32_t version = spirv[1];
+	const uint32_t bound = spirv[3];
+
+	std::vector<IdInfo> ids(bound);
+	auto info = [&](uint32_t id) -> IdInfo& {
+		if (id >= bound){
+			invalidModule("id out of bounds");
+		}
+		return ids[id];
+	};
+
+	ReflectData refl;
+	uint32_t entryPoint = 0;
+	bool sourceKnown = false, sourceHLSL = false, aliasedSSBOTypes = false;
+	std::array<uint32_t, 3> localSizeIds{};
+
+	// SSBO names depend on whether block types are shared, which is only known once every variable has been seen
+	std::vector<uint32_t> ssboVariables;
+
+	auto blockName = [&](uint32_t varId, const TypeInfo& type){
+		if (!ids[type.self].name.empty()){
+			return std::string(ids[type.self].name);
+		}
+		if (!ids[varId].name.empty()){
+			return std::string(ids[varId].name);
+		}
+		return "_" + std::to_string(type.self) + "_" + std::to_string(varId);
+	};
+
+	auto addVariable = [&](uint32_t typeId, uint32_t varId, spv::StorageClass storage){
+		if (storage == spv::StorageClassFunction){
+			return;
+		}
+		const auto& type = info(typeId).type;
+		auto& var = info(varId);
+		if (!type.pointer){
+			return;
+		}
+		auto& base = info(type.self);
+
+		const bool ssbo = storage == spv::StorageClassStorageBuffer || (storage == spv::StorageClassUniform && base.bufferBlock);
+		if (ssbo){
+			aliasedSSBOTypes |= base.ssboType;
+			base.ssboType = true;
+		}
+
+		// from SPIR-V 1.4, every global used by the entry point is in its interface
+		const bool io = storage == spv::StorageClassInput || storage == spv::StorageClassOutput;
+		if ((version >= 0x10400 || io) && !var.inInterface){
+			return;
+		}
+		if (var.builtin || base.builtinMember){
+			return;
+		}
+
+		std::vector<ReflectData::Resource>* list = nullptr;
+		bool useBlockName = false;
+		if (storage == spv::StorageClassInput){
+			list = &refl.stage_inputs;
+			useBlockName = base.block;
+		}
+		else if (storage == spv::StorageClassUniformConstant && type.op == spv::OpTypeImage && type.dim == spv::DimSubpassData){
+			list = &refl.subpass_inputs;
+		}
+		else if (storage == spv::StorageClassOutput){
+			list = &refl.stage_outputs;
+			useBlockName = base.block;
+		}
+		else if (type.storage == spv::StorageClassUniform && base.block){
+			list = &refl.uniform_buffers;
+			useBlockName = true;
+		}
+		else if ((type.storage == spv::StorageClassUniform && base.bufferBlock) || type.storage == spv::StorageClassStorageBuffer){
+			list = &refl.storage_buffers;
+			useBlockName = true;
+			ssboVariables.push_back(varId);
+		}
+		else if (type.storage == spv::StorageClassPushConstant){
+			list = &refl.push_constant_buffers;
+		}
+		else if (type.storage == spv::StorageClassAtomicCounter){
+			list = &refl.atomic_counters;
+		}
+		else if (type.storage == spv::StorageClassUniformConstant){
+			switch (type.op){
+				case spv::OpTypeImage:
+					if (type.sampled == 2){
+						list = &refl.storage_images;
+					}
+					else if (type.sampled == 1){
+						list = &refl.separate_images;
+					}
+					break;
+				case spv::OpTypeSampler:
+					list = &refl.separate_samplers;
+					break;
+				case spv::OpTypeSampledImage:
+					list = &refl.sampled_images;
+					break;
+				case spv::OpTypeAccelerationStructureKHR:
+					list = &refl.acceleration_structures;
+					break;
+				default:
+					break;
+			}
+		}
+		if (list == nullptr){
+			return;
+		}
+
+		ReflectData::Resource resource;
+		resource.id = varId;
+		resource.type_id = typeId;
+		resource.base_type_id = type.self;
+		resource.name = useBlockName ? blockName(varId, type) : std::string(var.name);
+		resource.set = var.set;
+		resource.binding = var.binding;
+		resource.location = var.location;
+		list->push_back(std::move(resource));
+	};
+
+	// every declaration precedes the first function, so the walk stops there
+	for (size_t offset = headerWords; offset < spirv.size();){
+		const uint32_t count = spirv[offset] >> spv::WordCountShift;
+		const auto op = spv::Op(spirv[offset] & spv::OpCodeMask);
+		if (count == 0 || offset + count > spirv.size()){
+			invalidModule("truncated instruction");
+		}
+		const uint32_t* ops = spirv.data() + offset + 1;
+		const uint32_t length = count - 1;
+		offset += count;
+
+		if (op == spv::OpFunction){
+			break;
+		}
+		switch (op){
+			case spv::OpSource:
+				if (length >= 1){
+					const auto language = spv::SourceLanguage(ops[0]);
+					sourceKnown = language == spv::SourceLanguageESSL || language == spv::SourceLanguageGLSL || language == spv::SourceLanguageHLSL;
+					sourceHLSL = language == spv::SourceLanguageHLSL;
+				}
+				break;
+			case spv::OpEntryPoint:
+				// only the first entry point is reflected
+				if (length >= 3 && entryPoint == 0){
+					entryPoint = ops[1];
+					const auto name = literalString(ops + 2, length - 2);
+					for (uint32_t i = 2 + uint32_t(name.size() + 4) / 4; i < length; i++){
+						info(ops[i]).inInterface = true;
+					}
+				}
+				break;
+			case spv::OpExecutionMode:
+			case spv::OpExecutionModeId:
+				if (length >= 5 && ops[0] == entryPoint){
+					if (ops[1] == spv::ExecutionModeLocalSize){
+						for (int i = 0; i < 3; i++){
+							refl.compute_dim[i] = uint16_t(ops[2 + i]);
+						}
+					}
+					else if (ops[1] == spv::ExecutionModeLocalSizeId){
+						std::copy_n(ops + 2, 3, localSizeIds.begin());
+					}
+				}
+				break;
+			case spv::OpName:
+				if (length >= 1){
+					info(ops[0]).name = literalString(ops + 1, length - 1);
+				}
+				break;
+			case spv::OpDecorate:
+				if (length >= 2){
+					auto& target = info(ops[0]);
+					const uint32_t value = length >= 3 ? ops[2] : 0;
+					switch (spv::Decoration(ops[1])){
+						case spv::DecorationBlock: target.block = true; break;
+						case spv::DecorationBufferBlock: target.bufferBlock = true; break;
+						case spv::DecorationBuiltIn: target.builtin = true; break;
+						case spv::DecorationLocation: target.location = value; break;
+						case spv::DecorationBinding: target.binding = value; break;
+						case spv::DecorationDescriptorSet: target.set = value; break;
+						default: break;
+					}
+				}
+				break;
+			case spv::OpMemberDecorate:
+				if (length >= 3 && ops[2] == spv::DecorationBuiltIn){
+					info(ops[0]).builtinMember = true;
+				}
+				break;
+			case spv::OpTypeVoid:
+			case spv::OpTypeBool:
+			case spv::OpTypeInt:
+			case spv::OpTypeFloat:
+			case spv::OpTypeVector:
+			case spv::OpTypeMatrix:
+			case spv::OpTypeSampler:
+			case spv::OpTypeStruct:
+			case spv::OpTypeOpaque:
+			case spv::OpTypeFunction:
+			case spv::OpTypeAccelerationStructureKHR:
+			case spv::OpTypeRayQueryKHR:
+				if (length >= 1){
+					auto& type = info(ops[0]).type;
+					type.op = op;
+					type.self = ops[0];
+				}
+				break;
+			case spv::OpTypeImage:
+				if (length >= 7){
+					auto& type = info(ops[0]).type;
+					type.op = op;
+					type.self = ops[0];
+					type.dim = spv::Dim(ops[2]);
+					type.sampled = ops[6];
+				}
+				break;
+			case spv::OpTypeSampledImage:
+				if (length >= 2){
+					auto& type = info(ops[0]).type;
+					type = info(ops[1]).type;
+					type.op = op;
+					type.self = ops[0];
+				}
+				break;
+			case spv::OpTypeArray:
+			case spv::OpTypeRuntimeArray:
+				if (length >= 2){
+					info(ops[0]).type = info(ops[1]).type;
+				}
+				break;
+			case spv::OpTypePointer:
+				if (length >= 3){
+					auto& type = info(ops[0]).type;
+					type = info(ops[2]).type;
+					type.pointer = true;
+					type.storage = spv::StorageClass(ops[1]);
+				}
+				break;
+			case spv::OpConstant:
+			case spv::OpSpecConstant:
+				if (length >= 3){
+					info(ops[1]).constant = ops[2];
+				}
+				break;
+			case spv::OpVariable:
+				if (length >= 3){
+					addVariable(ops[0], ops[1], spv::StorageClass(ops[2]));
+				}
+				break;
+			default:
+				break;
+		}
+	}
+
+	for (int i = 0; i < 3; i++){
+		if (localSizeIds[i] != 0){
+			refl.compute_dim[i] = uint16_t(info(localSizeIds[i]).constant);
+		}
+	}
+
+	// HLSL-style modules share one block type between buffers, so the instance name is the meaningful one
+	if (sourceKnown ? sourceHLSL : aliasedSSBOTypes){
+		for (size_t i = 0; i < ssboVariables.size(); i++){
+			const auto name = ids[ssboVariables[i]].name;
+			refl.storage_buffers[i].name = name.empty() ? "_" + std::to_string(ssboVariables[i]) : std::string(name);
+		}
+	}
+
+	// locations were recorded as the variables were found, so ordering is a plain key comparison
+	const auto byLocation = [](const ReflectData::Resource& a, const ReflectData::Resource& b){
+		return a.location < b.location;
+	};
+	std::stable_sort(refl.stage_inputs.begin(), refl.stage_inputs.end(), byLocation);
+	std::stable_sort(refl.stage_outputs.begin(), refl.stage_outputs.end(), byLocation);
+
+	return refl;
+}
@@ -0,0 +1,15 @@
+#pragma once
+#include <ShaderTranspiler.hpp>
+
+namespace shadert{
+
+/**
+ Collect the reflection data for a SPIR-V module in a single walk over its declarations.
+ Resources are classified the same way as SPIRV-Cross's get_shader_resources, and stage inputs and outputs
+ are ordered by location.
+ @param spirv the module
+ @return the reflection data
+ */
+ReflectData ReflectSPIRV(const spirvbytes& spirv);
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace shadert{
+
+/**
+ Incremental SHA-256, used to build content-addressed cache keys
+ */
+class Sha256{
+public:
+	using digest_t = std::array<uint8_t, 32>;
+
+	Sha256();
+
+	void Update(const void* data, size_t size);
+
+	void Update(std::string_view str){
+		Update(str.data(), str.size());
+	}
+
+	/**
+	 Hash a value with a length prefix, so that consecutive fields cannot alias each other
+	 */
+	void UpdateField(std::string_view str){
+		UpdateValue(uint64_t(str.size()));
+		Update(str);
+	}
+
+	template<typename T>
+	void UpdateValue(const T& value){
+		static_assert(std::is_trivially_copyable_v<T>);
+		Update(&value, sizeof(value));
+	}
+
+	digest_t Finish();
+
+	static std::string ToHex(const digest_t& digest);
+
+private:
+	void processBlock(const uint8_t* block);
+
+	std::array<uint32_t, 8> state;
+	std::array<uint8_t, 64> buffer;
+	uint64_t totalBytes = 0;
+	size_t bufferSize = 0;
+};
+
+}
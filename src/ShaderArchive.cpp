@@ -0,0 +1,467 @@
+#include <ShaderTranspiler.hpp>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+#include <unordered_set>
+
+#if __has_include(<sys/mman.h>)
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#define ST_HAS_MMAP 1
+#else
+#define ST_HAS_MMAP 0
+#endif
+
+using namespace shadert;
+namespace fs = std::filesystem;
+
+/*
+ Archive layout. All integers are in the byte order of the machine that wrote the archive, and every section starts
+ on an 8-byte boundary so that it can be read in place.
+
+ ArchiveHeader
+ records, one per entry: RecordHeader followed by its sections
+ keys
+ ArchiveEntry[entryCount]
+ uint32_t buckets[bucketCount]: open-addressed hash index of entry index + 1, or 0 for an empty bucket
+ */
+
+static constexpr uint32_t archiveMagic = 0x52415453;	// 'STAR'
+static constexpr uint32_t archiveVersion = 2;
+static constexpr size_t sectionAlignment = 8;
+static constexpr size_t numListStarts = size_t(ReflectionView::ResourceType::Count) + 1;
+
+struct ArchiveHeader{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entryCount;
+	uint32_t bucketCount;	// a power of two, or 0 for an empty archive
+	uint64_t entriesOffset;
+	uint64_t bucketsOffset;
+};
+
+struct ArchiveEntry{
+	uint64_t keyHash;
+	uint64_t keyOffset;
+	uint64_t recordOffset;
+	uint64_t recordSize;
+	uint32_t keyLength;
+	uint32_t reserved;
+};
+
+struct Section{
+	uint64_t offset;	// from the start of the record
+	uint64_t size;		// in bytes
+};
+
+struct RecordHeader{
+	Section source, binary, strings, columns, uniforms, attributes, includes;
+	uint32_t listStart[numListStarts];
+	uint16_t computeDim[3];
+	uint16_t reserved0;
+	uint32_t reserved1;
+};
+
+struct StringRef{
+	uint32_t offset, length;
+};
+
+struct UniformRecord{
+	StringRef name;
+	int32_t glDefineType;
+	uint16_t bufferOffset;
+	uint16_t texFormat;
+	uint8_t arraySize;
+	uint8_t texComponent;
+	uint8_t texDimension;
+	uint8_t reserved;
+};
+
+struct IncludeRecord{
+	StringRef path, hash;
+};
+
+static_assert(sizeof(ArchiveHeader) == 32 && sizeof(ArchiveEntry) == 40 && sizeof(RecordHeader) == 176 && sizeof(UniformRecord) == 20);
+
+// FNV-1a: stable across platforms and standard library versions, unlike std::hash
+static uint64_t hashKey(std::string_view key){
+	uint64_t hash = 0xcbf29ce484222325;
+	for (unsigned char c : key){
+		hash = (hash ^ c) * 0x100000001b3;
+	}
+	return hash;
+}
+
+static void padToAlignment(std::string& out){
+	out.resize((out.size() + sectionAlignment - 1) & ~(sectionAlignment - 1), '\0');
+}
+
+template<typename T>
+static void append(std::string& out, const T& value){
+	out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+[[noreturn]] static void invalidArchive(){
+	throw std::runtime_error("Invalid shader archive");
+}
+
+/**
+ @return a bounds-checked pointer to count objects at offset into bytes
+ */
+template<typename T>
+static const T* arrayAt(std::string_view bytes, uint64_t offset, uint64_t count){
+	if (offset % alignof(T) != 0 || offset > bytes.size() || count > (bytes.size() - offset) / sizeof(T)){
+		invalidArchive();
+	}
+	return reinterpret_cast<const T*>(bytes.data() + offset);
+}
+
+std::string ShaderArchiveWriter::encode(const CompileResult& result){
+	const auto& data = result.data;
+	const CompactReflectData reflection(data.reflectData);
+
+	// reflection names go first so that their offsets carry over unchanged
+	std::string strings(reflection.names);
+	std::unordered_map<std::string, uint32_t> interned;
+	auto addString = [&](std::string_view str){
+		auto [it, inserted] = interned.try_emplace(std::string(str), uint32_t(strings.size()));
+		if (inserted){
+			strings += str;
+		}
+		return StringRef{it->second, uint32_t(str.size())};
+	};
+
+	std::vector<UniformRecord> uniforms;
+	uniforms.reserve(data.uniformData.size());
+	for (const auto& uniform : data.uniformData){
+		uniforms.push_back({addString(uniform.name), uniform.glDefineType, uniform.bufferOffset, uniform.texFormat, uniform.arraySize,
+			uniform.texComponent, uniform.texDimension, 0});
+	}
+	std::vector<StringRef> attributes;
+	attributes.reserve(data.attributeData.size());
+	for (const auto& attribute : data.attributeData){
+		attributes.push_back(addString(attribute.name));
+	}
+	std::vector<IncludeRecord> includes;
+	includes.reserve(result.includes.size());
+	for (const auto& include : result.includes){
+		includes.push_back({addString(include.path.string()), addString(include.contentHash)});
+	}
+
+	RecordHeader header{};
+	std::string out(sizeof(header), '\0');
+	auto addSection = [&](const void* bytes, size_t size){
+		padToAlignment(out);
+		Section section{out.size(), size};
+		out.append(static_cast<const char*>(bytes), size);
+		return section;
+	};
+	header.binary = addSection(data.binaryData.data(), data.binaryData.size());
+	header.source = addSection(data.sourceData.data(), data.sourceData.size());
+	header.strings = addSection(strings.data(), strings.size());
+	header.columns = addSection(reflection.columns, size_t(ReflectionView::NumColumns) * reflection.listStart[numListStarts - 1] * sizeof(uint32_t));
+	header.uniforms = addSection(uniforms.data(), uniforms.size() * sizeof(uniforms[0]));
+	header.attributes = addSection(attributes.data(), attributes.size() * sizeof(attributes[0]));
+	header.includes = addSection(includes.data(), includes.size() * sizeof(includes[0]));
+	padToAlignment(out);
+
+	std::copy_n(reflection.listStart, numListStarts, header.listStart);
+	std::copy_n(reflection.computeDim.begin(), 3, header.computeDim);
+	std::memcpy(out.data(), &header, sizeof(header));
+	return out;
+}
+
+void ShaderArchiveWriter::Add(std::string key, const CompileResult& result){
+	entries.emplace_back(std::move(key), encode(result));
+}
+
+std::string ShaderArchiveWriter::Finish() const{
+	std::unordered_set<std::string_view> keys;
+	for (const auto& [key, record] : entries){
+		if (!keys.insert(key).second){
+			throw std::runtime_error("Duplicate key in shader archive: " + key);
+		}
+	}
+
+	std::string out(sizeof(ArchiveHeader), '\0');
+	std::vector<ArchiveEntry> index(entries.size());
+	for (size_t i = 0; i < entries.size(); i++){
+		padToAlignment(out);
+		index[i].recordOffset = out.size();
+		index[i].recordSize = entries[i].second.size();
+		out += entries[i].second;
+	}
+	for (size_t i = 0; i < entries.size(); i++){
+		const auto& key = entries[i].first;
+		index[i].keyHash = hashKey(key);
+		index[i].keyOffset = out.size();
+		index[i].keyLength = uint32_t(key.size());
+		out += key;
+	}
+
+	ArchiveHeader header{archiveMagic, archiveVersion, uint32_t(entries.size()), 0, 0, 0};
+	padToAlignment(out);
+	header.entriesOffset = out.size();
+	for (const auto& entry : index){
+		append(out, entry);
+	}
+
+	// keep the table at most half full so that probes stay short
+	if (!entries.empty()){
+		header.bucketCount = 1;
+		while (header.bucketCount < entries.size() * 2){
+			header.bucketCount *= 2;
+		}
+	}
+	std::vector<uint32_t> buckets(header.bucketCount, 0);
+	for (size_t i = 0; i < index.size(); i++){
+		auto bucket = index[i].keyHash & (header.bucketCount - 1);
+		while (buckets[bucket] != 0){
+			bucket = (bucket + 1) & (header.bucketCount - 1);
+		}
+		buckets[bucket] = uint32_t(i + 1);
+	}
+	padToAlignment(out);
+	header.bucketsOffset = out.size();
+	out.append(reinterpret_cast<const char*>(buckets.data()), buckets.size() * sizeof(buckets[0]));
+
+	std::memcpy(out.data(), &header, sizeof(header));
+	return out;
+}
+
+void ShaderArchiveWriter::Write(const fs::path& path) const{
+	const auto bytes = Finish();
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.write(bytes.data(), bytes.size())){
+		throw std::runtime_error("Could not write shader archive " + path.string());
+	}
+}
+
+ShaderArchive::ShaderArchive(std::string_view bytes, std::shared_ptr<const void> storage) : bytes(bytes), storage(std::move(storage)){
+	if (reinterpret_cast<uintptr_t>(bytes.data()) % sectionAlignment != 0){
+		throw std::runtime_error("Shader archive must be aligned to 8 bytes");
+	}
+	const auto& header = *arrayAt<ArchiveHeader>(bytes, 0, 1);
+	if (header.magic != archiveMagic || header.version != archiveVersion || (header.bucketCount & (header.bucketCount - 1)) != 0
+		|| header.bucketCount < header.entryCount){
+		invalidArchive();
+	}
+	arrayAt<ArchiveEntry>(bytes, header.entriesOffset, header.entryCount);
+	arrayAt<uint32_t>(bytes, header.bucketsOffset, header.bucketCount);
+}
+
+ShaderArchive ShaderArchive::FromBytes(std::string_view bytes){
+	return ShaderArchive(bytes);
+}
+
+ShaderArchive ShaderArchive::Open(const fs::path& path){
+	std::error_code ec;
+	const auto size = fs::file_size(path, ec);
+	if (ec){
+		throw std::runtime_error("Could not open shader archive " + path.string());
+	}
+#if ST_HAS_MMAP
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd >= 0 && size > 0){
+		void* addr = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if (addr != MAP_FAILED){
+			std::shared_ptr<const void> mapping(addr, [size](const void* addr){
+				::munmap(const_cast<void*>(addr), size);
+			});
+			return ShaderArchive(std::string_view(static_cast<const char*>(addr), size), std::move(mapping));
+		}
+	}
+	else if (fd >= 0){
+		::close(fd);
+	}
+#endif
+	// uint64_t elements keep the copy aligned
+	auto buffer = std::make_shared<std::vector<uint64_t>>((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+	std::ifstream file(path, std::ios::binary);
+	if (!file.read(reinterpret_cast<char*>(buffer->data()), size)){
+		throw std::runtime_error("Could not read shader archive " + path.string());
+	}
+	std::string_view bytes(reinterpret_cast<const char*>(buffer->data()), size);
+	return ShaderArchive(bytes, std::move(buffer));
+}
+
+size_t ShaderArchive::Size() const{
+	return bytes.empty() ? 0 : reinterpret_cast<const ArchiveHeader*>(bytes.data())->entryCount;
+}
+
+std::string_view ShaderArchive::Key(size_t index) const{
+	if (index >= Size()){
+		throw std::out_of_range("Shader archive index out of range");
+	}
+	const auto& header = *reinterpret_cast<const ArchiveHeader*>(bytes.data());
+	const auto& entry = reinterpret_cast<const ArchiveEntry*>(bytes.data() + header.entriesOffset)[index];
+	return std::string_view(arrayAt<char>(bytes, entry.keyOffset, entry.keyLength), entry.keyLength);
+}
+
+ShaderView ShaderArchive::At(size_t index) const{
+	if (index >= Size()){
+		throw std::out_of_range("Shader archive index out of range");
+	}
+	const auto& header = *reinterpret_cast<const ArchiveHeader*>(bytes.data());
+	const auto& entry = reinterpret_cast<const ArchiveEntry*>(bytes.data() + header.entriesOffset)[index];
+	if (entry.recordOffset % sectionAlignment != 0){
+		invalidArchive();
+	}
+	return ShaderView(arrayAt<char>(bytes, entry.recordOffset, entry.recordSize), entry.recordSize);
+}
+
+std::optional<ShaderView> ShaderArchive::Find(std::string_view key) const{
+	if (Size() == 0){
+		return std::nullopt;
+	}
+	const auto& header = *reinterpret_cast<const ArchiveHeader*>(bytes.data());
+	const auto entries = reinterpret_cast<const ArchiveEntry*>(bytes.data() + header.entriesOffset);
+	const auto buckets = reinterpret_cast<const uint32_t*>(bytes.data() + header.bucketsOffset);
+	const auto hash = hashKey(key);
+	const uint32_t mask = header.bucketCount - 1;
+	for (uint32_t probe = 0, bucket = hash & mask; probe < header.bucketCount; probe++, bucket = (bucket + 1) & mask){
+		const uint32_t slot = buckets[bucket];
+		if (slot == 0 || slot > header.entryCount){
+			break;
+		}
+		if (entries[slot - 1].keyHash == hash && Key(slot - 1) == key){
+			return At(slot - 1);
+		}
+	}
+	return std::nullopt;
+}
+
+ShaderView::ShaderView(const char* record, size_t size) : record(record){
+	const std::string_view bytes(record, size);
+	const auto& header = *arrayAt<RecordHeader>(bytes, 0, 1);
+	auto section = [&](const Section& section){
+		return std::string_view(arrayAt<char>(bytes, section.offset, section.size), section.size);
+	};
+	// check every section once here so that the accessors only need to index
+	for (const auto& s : {header.source, header.binary, header.strings}){
+		section(s);
+	}
+	arrayAt<UniformRecord>(bytes, header.uniforms.offset, header.uniforms.size / sizeof(UniformRecord));
+	arrayAt<StringRef>(bytes, header.attributes.offset, header.attributes.size / sizeof(StringRef));
+	arrayAt<IncludeRecord>(bytes, header.includes.offset, header.includes.size / sizeof(IncludeRecord));
+
+	for (size_t i = 0; i + 1 < numListStarts; i++){
+		if (header.listStart[i] > header.listStart[i + 1]){
+			invalidArchive();
+		}
+	}
+	const uint64_t total = header.listStart[numListStarts - 1];
+	if (header.listStart[0] != 0 || header.columns.size != total * ReflectionView::NumColumns * sizeof(uint32_t)){
+		invalidArchive();
+	}
+	const auto columns = arrayAt<uint32_t>(bytes, header.columns.offset, total * ReflectionView::NumColumns);
+
+	strings = section(header.strings);
+	reflection = ReflectionView(header.listStart, columns, strings, {header.computeDim[0], header.computeDim[1], header.computeDim[2]});
+}
+
+static const RecordHeader& recordHeader(const char* record){
+	return *reinterpret_cast<const RecordHeader*>(record);
+}
+
+template<typename T>
+static const T* sectionData(const char* record, const Section& section){
+	return reinterpret_cast<const T*>(record + section.offset);
+}
+
+std::string_view ShaderView::SourceData() const{
+	const auto& section = recordHeader(record).source;
+	return {sectionData<char>(record, section), section.size};
+}
+
+std::string_view ShaderView::BinaryData() const{
+	const auto& section = recordHeader(record).binary;
+	return {sectionData<char>(record, section), section.size};
+}
+
+WordView ShaderView::SpirvWords() const{
+	const auto& section = recordHeader(record).binary;
+	if (section.size % sizeof(uint32_t) != 0){
+		return {};
+	}
+	return {sectionData<uint32_t>(record, section), section.size / sizeof(uint32_t)};
+}
+
+size_t ShaderView::UniformCount() const{
+	return recordHeader(record).uniforms.size / sizeof(UniformRecord);
+}
+
+UniformView ShaderView::Uniform(size_t index) const{
+	if (index >= UniformCount()){
+		throw std::out_of_range("Uniform index out of range");
+	}
+	const auto& uniform = sectionData<UniformRecord>(record, recordHeader(record).uniforms)[index];
+	return {strings.substr(uniform.name.offset, uniform.name.length), uniform.glDefineType, uniform.arraySize, uniform.bufferOffset,
+		uniform.texComponent, uniform.texDimension, uniform.texFormat};
+}
+
+size_t ShaderView::AttributeCount() const{
+	return recordHeader(record).attributes.size / sizeof(StringRef);
+}
+
+std::string_view ShaderView::Attribute(size_t index) const{
+	if (index >= AttributeCount()){
+		throw std::out_of_range("Attribute index out of range");
+	}
+	const auto& name = sectionData<StringRef>(record, recordHeader(record).attributes)[index];
+	return strings.substr(name.offset, name.length);
+}
+
+size_t ShaderView::IncludeCount() const{
+	return recordHeader(record).includes.size / sizeof(IncludeRecord);
+}
+
+std::string_view ShaderView::IncludePath(size_t index) const{
+	if (index >= IncludeCount()){
+		throw std::out_of_range("Include index out of range");
+	}
+	const auto& include = sectionData<IncludeRecord>(record, recordHeader(record).includes)[index];
+	return strings.substr(include.path.offset, include.path.length);
+}
+
+std::string_view ShaderView::IncludeHash(size_t index) const{
+	if (index >= IncludeCount()){
+		throw std::out_of_range("Include index out of range");
+	}
+	const auto& include = sectionData<IncludeRecord>(record, recordHeader(record).includes)[index];
+	return strings.substr(include.hash.offset, include.hash.length);
+}
+
+CompileResult ShaderView::ToCompileResult() const{
+	CompileResult result;
+	auto& data = result.data;
+	data.sourceData = TextBuffer(std::string(SourceData()));
+	data.binaryData = BinaryBuffer::Copy(BinaryData());
+	data.reflectData = reflection.ToReflectData();
+
+	data.uniformData.reserve(UniformCount());
+	for (size_t i = 0; i < UniformCount(); i++){
+		const auto view = Uniform(i);
+		shadert::Uniform uniform;
+		uniform.name = view.name;
+		uniform.glDefineType = view.glDefineType;
+		uniform.arraySize = view.arraySize;
+		uniform.bufferOffset = view.bufferOffset;
+		uniform.texComponent = view.texComponent;
+		uniform.texDimension = view.texDimension;
+		uniform.texFormat = view.texFormat;
+		data.uniformData.push_back(std::move(uniform));
+	}
+	data.attributeData.reserve(AttributeCount());
+	for (size_t i = 0; i < AttributeCount(); i++){
+		data.attributeData.push_back({std::string(Attribute(i))});
+	}
+	result.includes.reserve(IncludeCount());
+	for (size_t i = 0; i < IncludeCount(); i++){
+		result.includes.push_back({std::string(IncludePath(i)), std::string(IncludeHash(i))});
+	}
+	return result;
+}
@@ -1,20 +1,35 @@
 #include <ShaderTranspiler.hpp>
 #include <SPIRV/GlslangToSpv.h>
-#include <StandAlone/DirStackFileIncluder.h>
+#include <glslang/Include/Types.h>
 #include <filesystem>
 #include <spirv_glsl.hpp>
 #include <spirv_hlsl.hpp>
 #include <spirv_msl.hpp>
 #include <spirv-tools/optimizer.hpp>
-#include <spirv_reflect.h>
 #include <iostream>
-#include <sstream>
 #include <utility>
+#include <optional>
+#include <map>
+#include <set>
+#include <algorithm>
 #if ST_ENABLE_WGSL
 #include <tint/tint.h>
 #endif
 #include <atomic>
 #include <mutex>
+#include "ThreadPool.hpp"
+#include "DiskCache.hpp"
+#include "MemoryCache.hpp"
+#include "IncludeCache.hpp"
+#include "OutputDeduplicator.hpp"
+#include "SpirvModule.hpp"
+#include "PushConstantLowering.hpp"
+#include "CompileContext.hpp"
+#include "PipelineContext.hpp"
+#include "Sha256.hpp"
+#include "OptimizerReport.hpp"
+#include "LockTiming.hpp"
+#include <glslang/build_info.h>
 
 #if (ST_BUNDLED_DXC == 1 || defined _MSC_VER)
 #define ST_DXIL_ENABLED
@@ -45,81 +60,7 @@ using namespace std;
 using namespace std::filesystem;
 using namespace shadert;
 
-static std::atomic<bool> glslAngInitialized = false;
-static std::atomic<bool> tintInit = false;
-static std::mutex tintInitMtx;
-
-ReflectData::Resource::Resource(const spirv_cross::Resource& other) : id(other.id), type_id(other.type_id), base_type_id(other.base_type_id), name(std::move(other.name)){}
-
-static ReflectData getReflectData(const spirv_cross::Compiler& comp, const spirvbytes& spirvdata){
-	auto rsc = comp.get_shader_resources();
-	ReflectData refl{
-		.uniform_buffers{rsc.uniform_buffers.data(),rsc.uniform_buffers.begin() + rsc.uniform_buffers.size()},
-		.storage_buffers{rsc.storage_buffers.data(),rsc.storage_buffers.begin() + rsc.storage_buffers.size()},
-		.stage_inputs{rsc.stage_inputs.data(),rsc.stage_inputs.begin() + rsc.stage_inputs.size()},
-		.stage_outputs{rsc.stage_outputs.data(),rsc.stage_outputs.begin() + rsc.stage_outputs.size()},
-		.subpass_inputs{rsc.subpass_inputs.data(),rsc.subpass_inputs.begin() + rsc.subpass_inputs.size()},
-		.storage_images{rsc.storage_images.data(),rsc.storage_images.begin() + rsc.storage_images.size()},
-		.sampled_images{rsc.sampled_images.data(),rsc.sampled_images.begin() + rsc.sampled_images.size()},
-		.atomic_counters{rsc.atomic_counters.data(),rsc.atomic_counters.begin() + rsc.atomic_counters.size()},
-		.acceleration_structures{rsc.acceleration_structures.data(),rsc.acceleration_structures.begin() + rsc.acceleration_structures.size()},
-		.push_constant_buffers{rsc.push_constant_buffers.data(),rsc.push_constant_buffers.begin() + rsc.push_constant_buffers.size()},
-		.separate_images{rsc.separate_images.data(),rsc.separate_images.begin() + rsc.separate_images.size()},
-		.separate_samplers{rsc.separate_samplers.data(),rsc.separate_samplers.begin() + rsc.separate_samplers.size()},
-	};
-	
-	
-	// since the data in stage_inputs, etc is in effectively random order
-	// we need to use spirv-reflect to get the locations and order them properly
-	SpvReflectShaderModule spvModule;
-	SpvReflectResult result = spvReflectCreateShaderModule(spirvdata.size() * sizeof(spirvdata[0]), spirvdata.data(), &spvModule);
-	if (result != SPV_REFLECT_RESULT_SUCCESS){
-		throw runtime_error(std::string("SPIRV reflection capture failed: ") + std::to_string(result));
-	}
-	
-	const auto sortfn = [](const auto& spvreflvars, auto& inoutscontainer){
-		std::unordered_map<std::string_view, uint16_t> varToPos;
-		for(const auto& var : spvreflvars){
-			if (var->name != nullptr) {
-				varToPos[var->name] = var->location;
-			}
-		}
-		
-		std::sort(inoutscontainer.begin(), inoutscontainer.end(), [&](const auto& a, const auto& b){
-			return varToPos[a.name] < varToPos[b.name];
-		});
-	};
-	
-	// sort inputs
-	{
-		uint32_t var_count = 0;
-		result = spvReflectEnumerateInputVariables(&spvModule, &var_count, NULL);
-		std::vector<SpvReflectInterfaceVariable*> input_vars;
-		input_vars.resize(var_count);
-		result = spvReflectEnumerateInputVariables(&spvModule, &var_count, input_vars.data());
-		
-		sortfn(input_vars, refl.stage_inputs);
-	}
-	// sort outputs
-	{
-		uint32_t var_count = 0;
-		result = spvReflectEnumerateOutputVariables(&spvModule, &var_count, NULL);
-		std::vector<SpvReflectInterfaceVariable*> output_vars;
-		output_vars.resize(var_count);
-		result = spvReflectEnumerateOutputVariables(&spvModule, &var_count, output_vars.data());
-		
-		sortfn(output_vars, refl.stage_outputs);
-	}
-    // get compute dispatch dimensions
-    for(int i = 0; i < 3; i++){
-        refl.compute_dim[i] = comp.get_execution_mode_argument(spv::ExecutionMode::ExecutionModeLocalSize, i);
-    }
-	
-	spvReflectDestroyShaderModule(&spvModule);
-	
-	return refl;
-}
-
+ReflectData::Resource::Resource(const spirv_cross::Resource& other) : id(other.id), type_id(other.type_id), base_type_id(other.base_type_id), name(other.name){}
 
 /**
 * Set the name of the main function 
@@ -238,20 +179,41 @@ TBuiltInResource CreateDefaultTBuiltInResource(){
 	};
 }
 
+//=========== vulkan versioning (should alow this to be passed in, or find out from the system) ========
+constexpr int ClientInputSemanticsVersion = 460;
+constexpr glslang::EShTargetClientVersion VulkanClientVersion = glslang::EShTargetVulkan_1_3;
+constexpr glslang::EShTargetLanguageVersion TargetVersion = glslang::EShTargetSpv_1_6;
+constexpr EShMessages glslangMessages = (EShMessages)(EShMsgSpvRules | EShMsgVulkanRules);
+
+/**
+ Set the input, client and target environment of a shader.
+ glslang caches built-in symbol tables per environment, so everything that parses must agree on this.
+ */
+static void configureShaderEnvironment(glslang::TShader& shader, EShLanguage ShaderType) {
+	shader.setEnvInput(glslang::EShSourceGlsl, ShaderType, glslang::EShClientVulkan, ClientInputSemanticsVersion);
+	shader.setEnvClient(glslang::EShClientVulkan, VulkanClientVersion);
+	shader.setEnvTarget(glslang::EShTargetSpv, TargetVersion);
+}
+
 struct CompileGLSLResult {
 	spirvbytes spirvdata;
 	std::vector<Uniform> uniforms;
 	std::vector<LiveAttribute> attributes;
+	std::vector<IncludedFile> includes;
+	std::vector<PushConstantMember> pushConstants;		// names the members in push constant lowering errors
 };
 
-const CompileGLSLResult CompileGLSL(const std::string_view& source, const std::string_view& sourceFileName, const EShLanguage ShaderType, const std::vector<std::filesystem::path>& includePaths, bool debug, bool enableInclude, std::string preamble = "", bool performWebGPUModifications = false) {
-	//initialize. Do only once per process!
-	if (!glslAngInitialized)
-	{
-		glslang::InitializeProcess();
-		glslAngInitialized = true;
-	}
+/**
+ A task with its source loaded, so that file and memory tasks look the same to the rest of the pipeline
+ */
+struct SourceInput {
+	std::string source;
+	std::string fileName;
+	ShaderStage stage;
+	std::vector<std::filesystem::path> includePaths;
+};
 
+const CompileGLSLResult CompileGLSL(const PipelineContext& ctx, IncludeFileCache& includeCache, const std::string_view& source, const std::string_view& sourceFileName, const EShLanguage ShaderType, const std::vector<std::filesystem::path>& includePaths, bool debug, bool enableInclude, std::string preamble = "") {
 	//determine the stage
 	glslang::TShader shader(ShaderType);
 
@@ -276,61 +238,13 @@ const CompileGLSLResult CompileGLSL(const std::string_view& source, const std::s
 	shader.addSourceText(source.data(), source.size());
 	shader.setStringsWithLengthsAndNames(strings, lengths, names,std::size(strings));
     
-    // remap push constants to uniform buffer
-	if (performWebGPUModifications) {
-        auto remapper = [&](){
-            // awful string parsing to find the name of the Uniform block
-            auto pushconstant_loc = source.find("push_constant");
-            if (pushconstant_loc == std::string::npos){
-                return;
-            }
-            auto uniform_loc = source.find("uniform",pushconstant_loc);
-            if (uniform_loc == std::string::npos){
-                return;
-            }
-            
-            auto brace_loc = source.find("{", uniform_loc);
-            if (brace_loc == std::string::npos){
-                return;
-            }
-            auto substr_begin = uniform_loc + sizeof("uniform")-1;
-            auto substr_size = brace_loc - (uniform_loc + sizeof("uniform")-1);
-            // 'trim' adjust ranges
-            for( ; substr_begin < brace_loc && std::isspace(source[substr_begin]); substr_begin++){
-                substr_size --;
-            }
-            for( ; substr_size > 0 && std::isspace(source[substr_begin + substr_size]); substr_size--){}
-            
-            auto blockname = source.substr(substr_begin, substr_size);
-            
-            std::string globalUniformBlockName(blockname);
-            
-            
-            shader.addBlockStorageOverride(globalUniformBlockName.c_str(), glslang::TBlockStorageClass::EbsUniform);
-        };
-        remapper();
-        
-        // WGSL
-    }
-
-
-	//=========== vulkan versioning (should alow this to be passed in, or find out from the system) ========
-    
-	constexpr int ClientInputSemanticsVersion = 460;
-	constexpr glslang::EShTargetClientVersion VulkanClientVersion = glslang::EShTargetVulkan_1_3;
-    constexpr glslang::EShTargetLanguageVersion TargetVersion = glslang::EShTargetSpv_1_6;
-
-	shader.setEnvInput(glslang::EShSourceGlsl, ShaderType, glslang::EShClientVulkan, ClientInputSemanticsVersion);
-	shader.setEnvClient(glslang::EShClientVulkan, VulkanClientVersion);
-	shader.setEnvTarget(glslang::EShTargetSpv, TargetVersion);
 
-	auto DefaultTBuiltInResource = CreateDefaultTBuiltInResource();
+	configureShaderEnvironment(shader, ShaderType);
 
-	TBuiltInResource Resources(DefaultTBuiltInResource);
-	EShMessages messages = (EShMessages)(EShMsgSpvRules | EShMsgVulkanRules);
+	EShMessages messages = glslangMessages;
 
 	// =============================== preprocess GLSL =============================
-	DirStackFileIncluder Includer;
+	CachingIncluder Includer(includeCache);
 
 	//Get Path of File
 	for (const auto& path : includePaths) {
@@ -340,20 +254,28 @@ const CompileGLSLResult CompileGLSL(const std::string_view& source, const std::s
 	shader.setPreamble(preamble.c_str());
 
 	// ================ now parse the shader ================
-	if (!shader.parse(&Resources, ClientInputSemanticsVersion, ECoreProfile, false, false, messages, Includer)){
-		string msg = string("GLSL Parsing failed: ") + shader.getInfoLog() + "\n" + shader.getInfoDebugLog();
-		throw std::runtime_error(msg);
+	{
+		StageScope stage(ctx, CompileStage::Parse);
+		if (!shader.parse(&ctx.compiler.Resources(), ClientInputSemanticsVersion, ECoreProfile, false, false, messages, Includer)){
+			string msg = string("GLSL Parsing failed: ") + shader.getInfoLog() + "\n" + shader.getInfoDebugLog();
+			throw std::runtime_error(msg);
+		}
 	}
+	ctx.checkpoint("parse");
 
 	// ============== pass parsed shader and link it ==============
 	glslang::TProgram program;
 	program.addShader(&shader);
 
-	if (!program.link(messages))
 	{
-		std::string msg = string("GLSL Linking failed:") + program.getInfoLog() + "\n" + program.getInfoDebugLog();
-		throw std::runtime_error(msg);
+		StageScope stage(ctx, CompileStage::Link);
+		if (!program.link(messages))
+		{
+			std::string msg = string("GLSL Linking failed:") + program.getInfoLog() + "\n" + program.getInfoDebugLog();
+			throw std::runtime_error(msg);
+		}
 	}
+	ctx.checkpoint("link");
 
 	CompileGLSLResult result;
 
@@ -370,7 +292,11 @@ const CompileGLSLResult CompileGLSL(const std::string_view& source, const std::s
 	}
     auto& intermediate = *program.getIntermediate(ShaderType);
     
-	glslang::GlslangToSpv(intermediate, result.spirvdata, &logger, &spvOptions);
+	{
+		StageScope stage(ctx, CompileStage::SpirvGeneration);
+		glslang::GlslangToSpv(intermediate, result.spirvdata, &logger, &spvOptions);
+	}
+	ctx.checkpoint("SPIR-V generation");
     
 #if 0
     spv_text text = nullptr;
@@ -380,6 +306,7 @@ const CompileGLSLResult CompileGLSL(const std::string_view& source, const std::s
 #endif
     
 	// get uniform information
+	StageScope reflectionStage(ctx, CompileStage::GlslReflection);
 	program.buildReflection();
 	auto nUniforms = program.getNumLiveUniformVariables();
 	for (int i = 0; i < nUniforms; i++) {
@@ -388,6 +315,13 @@ const CompileGLSLResult CompileGLSL(const std::string_view& source, const std::s
 		uniform.arraySize = program.getUniformArraySize(i);
 		uniform.bufferOffset = program.getUniformBufferOffset(i);
 		uniform.glDefineType = program.getUniformType(i);
+		const int block = program.getUniformBlockIndex(i);
+		if (block >= 0) {
+			const auto type = program.getUniformBlock(block).getType();
+			if (type && type->getQualifier().isPushConstant()) {
+				result.pushConstants.push_back({uniform.name, uint32_t(program.getUniform(i).offset)});
+			}
+		}
 		result.uniforms.push_back(std::move(uniform));
 	}
 
@@ -398,17 +332,18 @@ const CompileGLSLResult CompileGLSL(const std::string_view& source, const std::s
 		result.attributes.push_back({ name });
 	}
 
+	for (const auto& [path, file] : Includer.ServedFiles()) {
+		result.includes.push_back({std::filesystem::absolute(path).string(), file});
+	}
+
 	return result;
 }
 
 /**
- Compile GLSL to SPIR-V bytes
- @param filename the file to compile
- @param ShaderType the type of shader to compile
+ Load the GLSL source of a file task
+ @param task the task to load
  */
-const CompileGLSLResult CompileGLSLFromFile(const FileCompileTask& task, const EShLanguage ShaderType, bool debug, bool enableInclude, bool noPushConstants, std::string preamble = ""){
-	
-	
+static SourceInput LoadTask(const FileCompileTask& task){
 	//Load GLSL into a string
 	std::ifstream file(task.filename);
 	
@@ -417,13 +352,25 @@ const CompileGLSLResult CompileGLSLFromFile(const FileCompileTask& task, const E
 		throw std::runtime_error("failed to open file: " + task.filename.string());
 	}
 		
-	//read input file into string, convert to C string
+	//read input file into string
 	std::string InputGLSL((std::istreambuf_iterator<char>(file)),std::istreambuf_iterator<char>());
 	
 	// add current directory
-	std::vector<std::filesystem::path> pathsWithParent(std::move(task.includePaths));
+	std::vector<std::filesystem::path> pathsWithParent(task.includePaths);
 	pathsWithParent.push_back(task.filename.parent_path());
-	return CompileGLSL(InputGLSL, task.filename.string(), ShaderType, pathsWithParent, debug, enableInclude, preamble, noPushConstants);
+	return SourceInput{std::move(InputGLSL), task.filename.string(), task.stage, std::move(pathsWithParent)};
+}
+
+static SourceInput LoadTask(const MemoryCompileTask& task){
+	return SourceInput{task.source, task.sourceFileName, task.stage, task.includePaths};
+}
+
+/**
+ @return the reflection data of a module, timed as its own stage
+ */
+static const ReflectData& reflect(const PipelineContext& ctx, const SpirvModule& module){
+	StageScope stage(ctx, CompileStage::Reflection);
+	return module.Reflection();
 }
 
 /**
@@ -431,8 +378,9 @@ const CompileGLSLResult CompileGLSLFromFile(const FileCompileTask& task, const E
  @param bin the SPIR-V binary to decompile
  @return OpenGL-ES source code
  */
-IMResult SPIRVToOpenGL(const spirvbytes& bin, const Options& opt, spv::ExecutionModel model){
-	spirv_cross::CompilerGLSL glsl(bin);
+IMResult SPIRVToOpenGL(const PipelineContext& ctx, const SpirvModule& module, const Options& opt, spv::ExecutionModel model){
+	StageScope stage(ctx, CompileStage::CrossCompile);
+	spirv_cross::CompilerGLSL glsl(module.IR());
 		
 	//set options
 	spirv_cross::CompilerGLSL::Options options;
@@ -445,7 +393,7 @@ IMResult SPIRVToOpenGL(const spirvbytes& bin, const Options& opt, spv::Execution
 
 	setEntryPoint(glsl, opt.entryPoint);
 
-	return {glsl.compile(), "", getReflectData(glsl,bin)};
+	return {TextBuffer(glsl.compile()), {}, reflect(ctx, module)};
 }
 
 /**
@@ -453,8 +401,9 @@ IMResult SPIRVToOpenGL(const spirvbytes& bin, const Options& opt, spv::Execution
  @param bin the SPIR-V binary to decompile
  @return HLSL source code
  */
-IMResult SPIRVToHLSL(const spirvbytes& bin, const Options& opt, spv::ExecutionModel model){
-	spirv_cross::CompilerHLSL hlsl(bin);
+IMResult SPIRVToHLSL(const PipelineContext& ctx, const SpirvModule& module, const Options& opt, spv::ExecutionModel model){
+	StageScope stage(ctx, CompileStage::CrossCompile);
+	spirv_cross::CompilerHLSL hlsl(module.IR());
 	
 	spirv_cross::CompilerHLSL::Options options;
 	options.shader_model = opt.version;
@@ -464,13 +413,14 @@ IMResult SPIRVToHLSL(const spirvbytes& bin, const Options& opt, spv::ExecutionMo
 
 	setEntryPoint(hlsl, opt.entryPoint);
 
-	return {hlsl.compile(), "", getReflectData(hlsl,bin)};
+	return {TextBuffer(hlsl.compile()), {}, reflect(ctx, module)};
 }
 
 
-IMResult SPIRVToDXIL(const spirvbytes& bin, const Options& opt, spv::ExecutionModel model){
-	auto hlsl = SPIRVToHLSL(bin,opt,model);
+IMResult SPIRVToDXIL(const PipelineContext& ctx, const SpirvModule& module, const Options& opt, spv::ExecutionModel model){
+	auto hlsl = SPIRVToHLSL(ctx,module,opt,model);
 #ifdef ST_DXIL_ENABLED
+	StageScope stage(ctx, CompileStage::BinaryCompile);
 #if NEW_DXC
 
 	auto compileWithNewDxc = [&] {
@@ -560,8 +510,9 @@ IMResult SPIRVToDXIL(const spirvbytes& bin, const Options& opt, spv::ExecutionMo
 
 		ComPtr<IDxcBlob> pShaderBinary;
 		pCompileResult->GetOutput(DXC_OUT_OBJECT, IID_PPV_ARGS(pShaderBinary.GetAddressOf()), nullptr);
-		const auto binarySize = pShaderBinary->GetBufferSize();
-		hlsl.binaryData = decltype(hlsl.binaryData){(char*)pShaderBinary->GetBufferPointer(), binarySize};
+		// the blob is kept alive by the result instead of being copied out of it
+		auto binaryOwner = std::make_shared<const ComPtr<IDxcBlob>>(pShaderBinary);
+		hlsl.binaryData = BinaryBuffer(binaryOwner, pShaderBinary->GetBufferPointer(), pShaderBinary->GetBufferSize());
 	};
 #endif
 #if defined _MSC_VER
@@ -596,7 +547,9 @@ IMResult SPIRVToDXIL(const spirvbytes& bin, const Options& opt, spv::ExecutionMo
 			&errormsg
 		);
 		if (result == S_OK) {
-			hlsl.binaryData = decltype(hlsl.binaryData){(char*)code->GetBufferPointer(), code->GetBufferSize()};
+			const auto codeData = code->GetBufferPointer();
+			const auto codeSize = code->GetBufferSize();
+			hlsl.binaryData = BinaryBuffer(std::shared_ptr<const void>(code, [](ID3DBlob* blob) { blob->Release(); }), codeData, codeSize);
 		}
 		else {
 			throw runtime_error((char*)errormsg->GetBufferPointer());
@@ -629,8 +582,9 @@ IMResult SPIRVToDXIL(const spirvbytes& bin, const Options& opt, spv::ExecutionMo
  @param mobile set to True to compile for Apple Mobile platforms
  @return Metal shader source code
  */
-IMResult SPIRVtoMSL(const spirvbytes& bin, const Options& opt, spv::ExecutionModel model){
-	spirv_cross::CompilerMSL msl(bin);
+IMResult SPIRVtoMSL(const PipelineContext& ctx, const SpirvModule& module, const Options& opt, spv::ExecutionModel model){
+	StageScope stage(ctx, CompileStage::CrossCompile);
+	spirv_cross::CompilerMSL msl(module.IR());
 	
 	spirv_cross::CompilerMSL::Options options;
 	uint32_t major = opt.version / 10;
@@ -652,37 +606,38 @@ IMResult SPIRVtoMSL(const spirvbytes& bin, const Options& opt, spv::ExecutionMod
         }
     };
     
+	auto refldata = reflect(ctx, module);
+
+	// Every index is assigned through resource bindings before compiling. A binding covers all the Metal indices of
+	// a descriptor, so the ones that are not being changed keep the binding decoration, as enable_decoration_binding would.
+	std::map<std::pair<uint32_t, uint32_t>, spirv_cross::MSLResourceBinding> remaps;
+	auto remapFor = [&](uint32_t set, uint32_t binding) -> spirv_cross::MSLResourceBinding& {
+		auto [it, inserted] = remaps.try_emplace({set, binding});
+		if (inserted) {
+			it->second.stage = model;
+			it->second.desc_set = set;
+			it->second.binding = binding;
+			it->second.msl_buffer = binding;
+			it->second.msl_texture = binding;
+			it->second.msl_sampler = binding;
+		}
+		return it->second;
+	};
+	auto checkIndex = [](uint32_t index) {
+		if (index > 31) {
+			throw std::runtime_error("Adjusted index too large: " + std::to_string(index));
+		}
+		return index;
+	};
+
     // bindless stuff
     for(const auto& setting : opt.mtlDeviceAddressSettings){
         //msl.set_argument_buffer_device_address_space(setting.descSet, setting.deviceStorage);
-        spirv_cross::MSLResourceBinding newBinding;
-        newBinding.stage = model;
-        newBinding.desc_set = setting.descSet;
-        newBinding.binding = 0;
+        auto& newBinding = remapFor(setting.descSet, 0);
         newBinding.basetype = rgl2sc(setting.type);
         newBinding.msl_texture = setting.descSet;
         newBinding.msl_buffer = setting.descSet;
-        msl.add_msl_resource_binding( newBinding );
-    }
-    
-	auto refldata = getReflectData(msl,bin);
-    
-#if 0
-    if (model == spv::ExecutionModel::ExecutionModelVertex){
-        uint8_t currentIndex = opt.bufferBindingSettings.firstIndex;
-        for(auto& resource : refldata.storage_buffers){
-            spirv_cross::MSLResourceBinding newBinding;
-            newBinding.stage = model;
-            newBinding.desc_set = 0;
-            newBinding.basetype = msl.get_type(resource.base_type_id).basetype;
-            newBinding.binding = currentIndex;
-            newBinding.msl_buffer = currentIndex;
-            newBinding.msl_texture = currentIndex;
-            msl.add_msl_resource_binding( newBinding );
-            currentIndex++;
-        }
     }
-#endif
     
     if (opt.uniformBufferSettings.renameBuffer){
         if (refldata.uniform_buffers.size() > 0){
@@ -691,86 +646,105 @@ IMResult SPIRVtoMSL(const spirvbytes& bin, const Options& opt, spv::ExecutionMod
         }
     }
     
-    uint8_t currentIndex = opt.pushConstantSettings.firstIndex;
+	// give every descriptor a binding, so that SPIRV-Cross records the index of each one for reflection
+	for (auto list : { &refldata.uniform_buffers, &refldata.storage_buffers, &refldata.subpass_inputs, &refldata.storage_images, &refldata.sampled_images,
+		&refldata.atomic_counters, &refldata.acceleration_structures, &refldata.separate_images, &refldata.separate_samplers }) {
+		for (const auto& resource : *list) {
+			if (resource.set != ReflectData::Resource::Unassigned && resource.binding != ReflectData::Resource::Unassigned) {
+				remapFor(resource.set, resource.binding);
+			}
+		}
+	}
+
+	// vertex buffers occupy the first buffer indices of a vertex function, so its other buffers start after them
+	const uint32_t bufferOffset = model == spv::ExecutionModel::ExecutionModelVertex ? opt.bufferBindingSettings.stageInputSize : 0;
+	if (bufferOffset > 0) {
+		std::set<std::pair<uint32_t, uint32_t>> offsetBindings;
+		for (auto list : { &refldata.uniform_buffers, &refldata.storage_buffers }) {
+			for (const auto& resource : *list) {
+				if (resource.set != ReflectData::Resource::Unassigned && resource.binding != ReflectData::Resource::Unassigned && offsetBindings.insert({resource.set, resource.binding}).second) {
+					auto& newBinding = remapFor(resource.set, resource.binding);
+					newBinding.msl_buffer = checkIndex(newBinding.msl_buffer + bufferOffset);
+				}
+			}
+		}
+	}
+
+    uint32_t currentIndex = opt.pushConstantSettings.firstIndex + bufferOffset;
     for(auto& resource : refldata.push_constant_buffers){
         spirv_cross::MSLResourceBinding newBinding;
         newBinding.stage = model;
         newBinding.desc_set = spirv_cross::ResourceBindingPushConstantDescriptorSet;
         newBinding.binding = spirv_cross::ResourceBindingPushConstantBinding;
-        newBinding.msl_buffer = currentIndex;
+        newBinding.msl_buffer = bufferOffset > 0 ? checkIndex(currentIndex) : currentIndex;
         msl.add_msl_resource_binding( newBinding );
         
         currentIndex++;
     }
+
+	// Number samplers sequentially, in the order SPIRV-Cross declares them: by their index, then by id.
+	// Only the samplers the entry point uses are declared.
+	{
+		const auto active = msl.get_active_interface_variables();
+		struct SamplerSlot {
+			uint32_t index, id, count;
+			spirv_cross::MSLResourceBinding* binding;
+		};
+		std::vector<SamplerSlot> samplers;
+		auto addSamplers = [&](const std::vector<ReflectData::Resource>& resources, bool combined) {
+			for (const auto& resource : resources) {
+				const auto& type = msl.get_type(resource.type_id);
+				if (!active.count(resource.id) || resource.set == ReflectData::Resource::Unassigned || resource.binding == ReflectData::Resource::Unassigned || (combined && type.image.dim == spv::DimBuffer)) {
+					continue;
+				}
+				uint32_t count = 1;
+				for (auto size : type.array) {
+					count *= std::max(size, 1u);
+				}
+				auto& binding = remapFor(resource.set, resource.binding);
+				samplers.push_back({ binding.msl_sampler, resource.id, count, &binding });
+			}
+		};
+		addSamplers(refldata.sampled_images, true);
+		addSamplers(refldata.separate_samplers, false);
+		std::sort(samplers.begin(), samplers.end(), [](const SamplerSlot& a, const SamplerSlot& b) {
+			return std::tie(a.index, a.id) < std::tie(b.index, b.id);
+		});
+		uint32_t samplerIdx = 0;
+		for (const auto& sampler : samplers) {
+			sampler.binding->msl_sampler = checkIndex(samplerIdx);
+			samplerIdx += sampler.count;
+		}
+	}
+
+	for (const auto& [key, binding] : remaps) {
+		msl.add_msl_resource_binding(binding);
+	}
     
 	setEntryPoint(msl, opt.entryPoint);
     auto res = msl.compile();
+
+	// report the indices the resources ended up with, or Unassigned for those the entry point does not use
+	for (auto list : { &refldata.uniform_buffers, &refldata.storage_buffers, &refldata.subpass_inputs, &refldata.storage_images, &refldata.sampled_images, &refldata.atomic_counters,
+		&refldata.acceleration_structures, &refldata.push_constant_buffers, &refldata.separate_images, &refldata.separate_samplers }) {
+		for (auto& resource : *list) {
+			resource.binding = msl.get_automatic_msl_resource_binding(resource.id);
+		}
+	}
+	for (auto& resource : refldata.sampled_images) {
+		resource.samplerBinding = msl.get_automatic_msl_resource_binding_secondary(resource.id);
+	}
     
-    // renumber buffers the hacky way
-    constexpr auto resourceRenumber = [](auto&& res, auto&& opt, const std::string_view tag, auto&& renumberFn){
-        constexpr auto atoi_n = [](std::string_view str)
-        {
-            int ret = 0;
-            for(int i = 0; i < str.size(); ++i)
-            {
-                ret = ret * 10 + (str[i] - '0');
-            }
-            return ret;
-        };
-        
-        auto taglen = tag.size();
-        size_t itr = 0;
-        while (itr < res.size()){
-            itr = res.find(tag.data(), itr, taglen);
-            if (itr == std::string::npos){
-                break;
-            }
-            auto blockEnd = res.find(")",itr);
-            
-            const auto begin = itr + taglen;
-            
-            string_view rangeStr(res.data() + begin, blockEnd - itr - taglen);
-            
-            auto value = atoi_n(rangeStr);
-            
-            value = renumberFn(value);
-            
-            if (value > 31){
-                throw std::runtime_error("Adjusted index too large: " + std::to_string(value));
-            }
-            
-            // insert the value
-            res = res.substr(0, begin) + std::to_string(value) + res.substr(blockEnd);
-            
-            itr++;
-        }
-    };
-    
-    if (model == spv::ExecutionModel::ExecutionModelVertex && opt.bufferBindingSettings.stageInputSize > 0){
-        resourceRenumber(res,opt,"[[buffer(",[&opt](auto value){
-            return value + opt.bufferBindingSettings.stageInputSize;
-        });
-    }
-    {
-        uint32_t samplerIdx = 0;
-        resourceRenumber(res,opt,"[[sampler(",[&opt,&samplerIdx](auto value){
-            return samplerIdx++;
-        });
-    }
-    
-	return {std::move(res), "", std::move(refldata)};
+	return {TextBuffer(std::move(res)), {}, std::move(refldata)};
 }
 
-IMResult SPIRVToWGSL(const spirvbytes& bin, const Options& opt, spv::ExecutionModel model) {
+IMResult SPIRVToWGSL(const PipelineContext& ctx, const SpirvModule& module, const Options& opt, spv::ExecutionModel model) {
 #if ST_ENABLE_WGSL
-	tintInitMtx.lock();
-	if (!tintInit) {
-		tint::Initialize();
-		tintInit = true;
-	}
-	tintInitMtx.unlock();
-
-	auto tintprogram = tint::reader::spirv::Parse(bin, {
+	StageScope stage(ctx, CompileStage::CrossCompile);
+	// tint is initialized by CompileContext
+	// WGSL has no push constants
+	const auto& settings = opt.pushConstantSettings;
+	auto tintprogram = tint::reader::spirv::Parse(LowerPushConstants(module.Bytes(), settings.uniformBufferSet, settings.uniformBufferBinding, ctx.pushConstants), {
 		.allow_non_uniform_derivatives = true	
 	});
 	if (tintprogram.Diagnostics().contains_errors()) {
@@ -782,85 +756,48 @@ IMResult SPIRVToWGSL(const spirvbytes& bin, const Options& opt, spv::ExecutionMo
 		throw std::runtime_error(result.error);
 	}
 
-	return { result.wgsl, "", {} };
+	return { TextBuffer(result.wgsl), {}, {} };
 #else
 	throw std::runtime_error("ShaderTranspiler was not compiled with WGSL output support");
 #endif
 }
 
 #if __APPLE__
-extern IMResult SPIRVtoMBL(const spirvbytes& bin, const Options& opt, spv::ExecutionModel model);
+extern IMResult SPIRVtoMBL(const PipelineContext& ctx, const SpirvModule& module, const Options& opt, spv::ExecutionModel model);
 #endif
 /**
- Serialize a SPIR-V binary
- @param bin the binary
- */
-CompileResult SerializeSPIRV(const spirvbytes& bin){
-	ostringstream buffer(ios::binary);
-	buffer.write((char*)&bin[0], bin.size() * sizeof(uint32_t));
-	return CompileResult{{.sourceData = "", .binaryData = buffer.str()}};
-}
-
-/**
- Perform standard optimizations on a SPIR-V binary
+ Optimize a SPIR-V binary
+ @param ctx provides the optimizer
  @param bin the SPIR-V binary to optimize
- @param options settings for the optimizer
+ @param level which passes to run. Must not be OptimizationLevel::None.
+ @param passes the spirv-opt flags for OptimizationLevel::Custom
  */
-spirvbytes OptimizeSPIRV(const spirvbytes& bin, const Options &options){
-	
-	spv_target_env target;
-	switch(options.version){
-		case 10:
-			target = SPV_ENV_UNIVERSAL_1_0;
-			break;
-		case 11:
-			target = SPV_ENV_UNIVERSAL_1_1;
-			break;
-		case 12:
-			target = SPV_ENV_UNIVERSAL_1_2;
-			break;
-		case 13:
-			target = SPV_ENV_UNIVERSAL_1_3;
-			break;
-		case 14:
-			target = SPV_ENV_UNIVERSAL_1_4;
-			break;
-		case 15:
-			target = SPV_ENV_UNIVERSAL_1_5;
-			break;
-		default:
-			throw runtime_error("Unknown Vulkan version");
-			break;
-	}
-	
-	spvtools::MessageConsumer consumer = [&](spv_message_level_t level, const char* source, const spv_position_t& position, const char* message){
-		switch(level){
-			case SPV_MSG_FATAL:
-			case SPV_MSG_INTERNAL_ERROR:
-			case SPV_MSG_ERROR:
-				throw runtime_error(message);
-				break;
-            case SPV_MSG_WARNING:
-            case SPV_MSG_INFO:
-            case SPV_MSG_DEBUG:
-                break;
-        }
-	};
-    
-    //create a general optimizer
-	spvtools::Optimizer optimizer(target);
-	optimizer.RegisterSizePasses();
-	optimizer.RegisterPerformancePasses();
-	optimizer.RegisterLegalizationPasses();
-	optimizer.SetMessageConsumer(consumer);
+spirvbytes OptimizeSPIRV(const PipelineContext& ctx, const spirvbytes& bin, OptimizationLevel level, const std::vector<std::string>& passes){
+	// the front end always produces SPIR-V for TargetVersion, whatever the target API and its version
+	static_assert(TargetVersion == glslang::EShTargetSpv_1_6, "update the optimizer environment to match the front end");
+	constexpr spv_target_env target = SPV_ENV_UNIVERSAL_1_6;
 	
+	std::optional<OptimizerTimeReport> report;
 	spirvbytes newbin;
-	if (optimizer.Run(bin.data(), bin.size(), &newbin)){
-		return newbin;
+	{
+		StageScope stage(ctx, CompileStage::Optimization);
+		auto optimizer = ctx.compiler.MakeOptimizer(target, level, passes);
+		if (ctx.optimizerPasses) {
+			report.emplace();
+			optimizer->SetTimeReport(report->Stream());
+		}
+		if (!optimizer->Run(bin.data(), bin.size(), &newbin)){
+			throw runtime_error("Failed optimizing SPIR-V binary");
+		}
 	}
-	else{
-		throw runtime_error("Failed optimizing SPIR-V binary");
+	if (ctx.stats) {
+		ctx.stats->optimizedSpirvWords = newbin.size();
 	}
+	if (report) {
+		auto passes = report->Passes();
+		ctx.optimizerPasses->insert(ctx.optimizerPasses->end(), std::make_move_iterator(passes.begin()), std::make_move_iterator(passes.end()));
+	}
+	return newbin;
 }
 
 struct APIConversion {
@@ -900,40 +837,34 @@ static APIConversion ShaderStageToInternal(ShaderStage api) {
 	return cv;
 }
 
-static CompileResult CompileSpirVTo(const spirvbytes& spirv, TargetAPI api, const Options& opt,  APIConversion types) {
+static CompileResult CompileSpirVTo(const PipelineContext& ctx, const SpirvModule& spirv, TargetAPI api, const Options& opt,  APIConversion types) {
 	switch (api) {
 	case TargetAPI::OpenGL:
 	case TargetAPI::OpenGL_ES:
-		return CompileResult{ SPIRVToOpenGL(spirv,opt,types.model) };
+		return CompileResult{ SPIRVToOpenGL(ctx,spirv,opt,types.model) };
 		break;
 	case TargetAPI::Vulkan:
-		if (opt.debug) {
-			// don't optimize it
-			return SerializeSPIRV(spirv);
-		}
-		else {
-			return SerializeSPIRV(OptimizeSPIRV(spirv, opt));
-		}
-		
+		// optimization has already happened in RunBackend
+		return CompileResult{{.binaryData = spirv.Binary()}};
 		break;
 	case TargetAPI::HLSL:
-		return CompileResult{ SPIRVToHLSL(spirv,opt,types.model) };
+		return CompileResult{ SPIRVToHLSL(ctx,spirv,opt,types.model) };
 		break;
 	case TargetAPI::Metal:
-		return CompileResult{ SPIRVtoMSL(spirv,opt,types.model) };
+		return CompileResult{ SPIRVtoMSL(ctx,spirv,opt,types.model) };
 		break;
 #ifdef ST_DXIL_ENABLED
 	case TargetAPI::DXIL:
-		return CompileResult{ SPIRVToDXIL(spirv,opt,types.model) };
+		return CompileResult{ SPIRVToDXIL(ctx,spirv,opt,types.model) };
 		break;
 #endif
 #ifdef __APPLE__
 	case TargetAPI::MetalBinary:
-		return CompileResult{SPIRVtoMBL(spirv,opt,types.model)};
+		return CompileResult{SPIRVtoMBL(ctx,spirv,opt,types.model)};
 		break;
 #endif
 	case TargetAPI::WGSL:
-		return CompileResult{ SPIRVToWGSL(spirv,opt,types.model) };
+		return CompileResult{ SPIRVToWGSL(ctx,spirv,opt,types.model) };
 		break;
 	default:
 		throw runtime_error("Unsupported API");
@@ -941,27 +872,615 @@ static CompileResult CompileSpirVTo(const spirvbytes& spirv, TargetAPI api, cons
 	}
 }
 
-CompileResult ShaderTranspiler::CompileTo(const FileCompileTask& task, TargetAPI api, const Options& opt) {
+/**
+ @return the optimization that a backend gets for the options
+ */
+static OptimizationLevel BackendOptimization(TargetAPI api, const Options& opt) {
+	if (opt.debug) {
+		return OptimizationLevel::None;
+	}
+	if (opt.optimization == OptimizationLevel::Default) {
+		// source-language targets have always been compiled from the front end's SPIR-V
+		return api == TargetAPI::Vulkan ? OptimizationLevel::Default : OptimizationLevel::None;
+	}
+	return opt.optimization;
+}
 
-	auto types = ShaderStageToInternal(task.stage);
+/**
+ Optimize the SPIR-V for a backend, as requested by the options. The optimization does not depend on the target, so
+ it runs once per module and is shared by every target compiled from that module with the same level and passes.
+ @return the optimized module, or nullptr if the backend takes the module as-is
+ */
+static const SpirvModule* OptimizeForBackend(const PipelineContext& ctx, const SpirvModule& module, TargetAPI api, const Options& opt) {
+	const auto level = BackendOptimization(api, opt);
+	if (level == OptimizationLevel::None) {
+		return nullptr;
+	}
+	std::string key(1, char(level));
+	if (level == OptimizationLevel::Custom) {
+		for (const auto& pass : opt.optimizerPasses) {
+			key += '\n' + pass;
+		}
+	}
+	return &module.Optimized(key, [&]{
+		return OptimizeSPIRV(ctx, module.Bytes(), level, opt.optimizerPasses);
+	});
+}
+
+/**
+ Hash every Options field that can change the output of a backend, given its SPIR-V. Keep this in sync with Options.
+ */
+static void hashBackendOptions(Sha256& hash, const Options& opt) {
+	hash.UpdateValue(opt.version);
+	hash.UpdateValue(opt.mobile);
+	hash.UpdateValue(opt.debug);
+	hash.UpdateValue(opt.optimization);
+	hash.UpdateValue(uint64_t(opt.optimizerPasses.size()));
+	for (const auto& pass : opt.optimizerPasses) {
+		hash.UpdateField(pass);
+	}
+	hash.UpdateField(opt.entryPoint);
+	hash.UpdateField(opt.uniformBufferSettings.newBufferName);
+	hash.UpdateValue(opt.uniformBufferSettings.renameBuffer);
+	hash.UpdateValue(uint64_t(opt.mtlDeviceAddressSettings.size()));
+	for (const auto& setting : opt.mtlDeviceAddressSettings) {
+		hash.UpdateValue(setting.descSet);
+		hash.UpdateValue(setting.deviceStorage);
+		hash.UpdateValue(setting.type);
+	}
+	hash.UpdateValue(opt.pushConstantSettings.firstIndex);
+	hash.UpdateValue(opt.pushConstantSettings.uniformBufferSet);
+	hash.UpdateValue(opt.pushConstantSettings.uniformBufferBinding);
+	hash.UpdateValue(opt.bufferBindingSettings.stageInputSize);
+}
+
+/**
+ Compute the key under which the output of a backend is shared within a batch
+ @param stage distinguishes keys made before and after optimization
+ */
+static Sha256::digest_t ComputeBackendKey(const spirvbytes& spirv, TargetAPI api, const Options& opt, APIConversion types, const char* stage) {
+	Sha256 hash;
+	hash.UpdateField(stage);
+	hash.UpdateValue(api);
+	hash.UpdateValue(types.model);
+	hashBackendOptions(hash, opt);
+	hash.Update(spirv.data(), spirv.size() * sizeof(spirv[0]));
+	return hash.Finish();
+}
+
+/**
+ Optimize and cross-compile a module. In a batch, a module that was already compiled by another job
+ with the same settings is not compiled again, both before and after optimization.
+ */
+static IMResult RunBackend(const PipelineContext& ctx, const SpirvModule& module, TargetAPI api, const Options& opt, APIConversion types) {
+	auto optimizeAndCompile = [&]{
+		auto optimized = OptimizeForBackend(ctx, module, api, opt);
+		if (!optimized) {
+			return CompileSpirVTo(ctx, module, api, opt, types).data;
+		}
+		ctx.checkpoint("optimization");
+		const SpirvModule& optimizedModule = *optimized;
+		if (!ctx.dedup) {
+			return CompileSpirVTo(ctx, optimizedModule, api, opt, types).data;
+		}
+		// different modules can optimize to the same module
+		return ctx.dedup->Run(ComputeBackendKey(optimizedModule.Bytes(), api, opt, types, "optimized"), ctx.jobId, [&]{
+			return CompileSpirVTo(ctx, optimizedModule, api, opt, types).data;
+		});
+	};
+	if (!ctx.dedup) {
+		return optimizeAndCompile();
+	}
+	return ctx.dedup->Run(ComputeBackendKey(module.Bytes(), api, opt, types, "unoptimized"), ctx.jobId, optimizeAndCompile);
+}
+
+/**
+ Run the GLSL front end for a task
+ @param includeCache where to look up included files
+ @param input the loaded task to compile
+ @param types the internal stage representation
+ @param opt the options for this compile
+ */
+static CompileGLSLResult CompileGLSLFromTask(const PipelineContext& ctx, IncludeFileCache& includeCache, const SourceInput& input, APIConversion types, const Options& opt) {
+	return CompileGLSL(ctx, includeCache, input.source, input.fileName, types.type, input.includePaths, opt.debug, opt.enableInclude, opt.preambleContent);
+}
+
+/**
+ Hash every Options field that can change the output. Keep this in sync with Options.
+ */
+static void hashOptions(Sha256& hash, const Options& opt) {
+	hashBackendOptions(hash, opt);
+	hash.UpdateValue(opt.enableInclude);
+	hash.UpdateField(opt.preambleContent);
+	hash.UpdateValue(opt.hashIncludes);
+}
+
+/**
+ Hash the loaded task and the versions of everything that processes it
+ */
+static void hashInput(Sha256& hash, const SourceInput& input) {
+	// bump this when a change to the library changes its output
+	constexpr uint32_t cacheVersion = 4;
+
+	hash.UpdateValue(cacheVersion);
+	hash.UpdateValue(std::array<int, 3>{GLSLANG_VERSION_MAJOR, GLSLANG_VERSION_MINOR, GLSLANG_VERSION_PATCH});
+	hash.UpdateField(spvSoftwareVersionDetailsString());
+	// the backends have no version numbers, so CMake identifies their sources
+	for (const auto id : {ST_SPIRV_CROSS_ID, ST_SPIRV_REFLECT_ID, ST_TINT_ID, ST_DXC_ID}) {
+		hash.UpdateField(id);
+	}
+	hash.UpdateValue(ST_ENABLE_WGSL);
+	hash.UpdateField(input.source);
+	hash.UpdateField(input.fileName);
+	hash.UpdateValue(input.stage);
+	hash.UpdateValue(uint64_t(input.includePaths.size()));
+	for (const auto& path : input.includePaths) {
+		hash.UpdateField(path.string());
+	}
+}
+
+/**
+ Compute the cache key for a front-end compile. Include contents are accounted for by the caches themselves.
+ */
+static Sha256::digest_t ComputeFrontEndKey(const SourceInput& input, const Options& opt) {
+	Sha256 hash;
+	hashInput(hash, input);
+	hash.UpdateValue(opt.debug);
+	hash.UpdateValue(opt.enableInclude);
+	hash.UpdateField(opt.preambleContent);
+	return hash.Finish();
+}
+
+/**
+ Compute the cache key for a complete compile. Include contents are accounted for by the caches themselves.
+ */
+static Sha256::digest_t ComputeCacheKey(const SourceInput& input, TargetAPI api, const Options& opt) {
+	Sha256 hash;
+	hashInput(hash, input);
+	hash.UpdateValue(api);
+	hashOptions(hash, opt);
+	return hash.Finish();
+}
+
+static size_t estimateSize(const CompileGLSLResult& result) {
+	size_t size = sizeof(result) + result.spirvdata.size() * sizeof(result.spirvdata[0]);
+	for (const auto& uniform : result.uniforms) {
+		size += sizeof(uniform) + uniform.name.size();
+	}
+	for (const auto& attribute : result.attributes) {
+		size += sizeof(attribute) + attribute.name.size();
+	}
+	for (const auto& member : result.pushConstants) {
+		size += sizeof(member) + member.name.size();
+	}
+	return size;
+}
+
+static size_t estimateSize(const CompileResult& result) {
+	const auto& data = result.data;
+	// binaryData may share its storage with other results, so this can overestimate
+	size_t size = sizeof(result) + data.sourceData.size() + data.binaryData.size();
+	for (const auto& include : result.includes) {
+		size += sizeof(include) + include.path.native().size() * sizeof(std::filesystem::path::value_type) + include.contentHash.size();
+	}
+	for (auto list : { &data.reflectData.uniform_buffers, &data.reflectData.storage_buffers, &data.reflectData.stage_inputs, &data.reflectData.stage_outputs,
+		&data.reflectData.subpass_inputs, &data.reflectData.storage_images, &data.reflectData.sampled_images, &data.reflectData.atomic_counters,
+		&data.reflectData.acceleration_structures, &data.reflectData.push_constant_buffers, &data.reflectData.separate_images, &data.reflectData.separate_samplers }) {
+		for (const auto& resource : *list) {
+			size += sizeof(resource) + resource.name.size();
+		}
+	}
+	for (const auto& uniform : data.uniformData) {
+		size += sizeof(uniform) + uniform.name.size();
+	}
+	for (const auto& attribute : data.attributeData) {
+		size += sizeof(attribute) + attribute.name.size();
+	}
+	return size;
+}
+
+struct MemoryCache {
+	MemoryCache(size_t maxBytes) : spirv(maxBytes / 2), results(maxBytes / 2) {}
+
+	ShardedLRUCache<CompileGLSLResult> spirv;
+	ShardedLRUCache<CompileResult> results;
+};
+
+/**
+ The state owned by a ShaderTranspiler instance. Shared with its in-flight async compiles.
+ */
+struct shadert::TranspilerState {
+	std::shared_ptr<DiskCache> GetDiskCache() {
+		TimedLock lock(mtx);
+		return diskCache;
+	}
+
+	void SetDiskCache(std::shared_ptr<DiskCache> cache) {
+		TimedLock lock(mtx);
+		diskCache = std::move(cache);
+	}
+
+	IncludeFileCache& GetIncludeCache() {
+		return includeCache;
+	}
+
+	std::shared_ptr<MemoryCache> GetMemoryCache() {
+		TimedLock lock(mtx);
+		return memoryCache;
+	}
+
+	void SetMemoryCache(std::shared_ptr<MemoryCache> cache) {
+		TimedLock lock(mtx);
+		memoryCache = std::move(cache);
+	}
+
+	std::shared_ptr<CompileTrace> GetTrace() {
+		TimedLock lock(mtx);
+		return trace;
+	}
+
+	void SetTrace(std::shared_ptr<CompileTrace> newTrace) {
+		TimedLock lock(mtx);
+		trace = std::move(newTrace);
+	}
+
+private:
+	std::mutex mtx;
+	std::shared_ptr<DiskCache> diskCache;
+	std::shared_ptr<MemoryCache> memoryCache;
+	std::shared_ptr<CompileTrace> trace;
+	IncludeFileCache includeCache;
+};
+
+/**
+ Front-end results for one SourceInput, created on first use and shared by every target compiled from it
+ */
+struct FrontEndSlot {
+	std::shared_ptr<const CompileGLSLResult> glsl;
+	std::unique_ptr<SpirvModule> module;		// parsed once for all SPIRV-Cross backends
+};
+
+static std::shared_ptr<const CompileGLSLResult> RunFrontEnd(TranspilerState& state, const PipelineContext& ctx, const SourceInput& input, APIConversion types, const Options& opt) {
+	auto memoryCache = state.GetMemoryCache();
+	Sha256::digest_t key;
+	if (memoryCache) {
+		key = ComputeFrontEndKey(input, opt);
+		if (auto cached = memoryCache->spirv.Find(key)) {
+			return cached;
+		}
+	}
+
+	auto result = std::make_shared<const CompileGLSLResult>(CompileGLSLFromTask(ctx, state.GetIncludeCache(), input, types, opt));
+	if (memoryCache) {
+		if (auto stamps = StampIncludes(result->includes)) {
+			memoryCache->spirv.Insert(key, result, estimateSize(*result), std::move(*stamps));
+		}
+	}
+	return result;
+}
+
+/**
+ Convert the includes reported by the front end for CompileResult
+ @param withHashes set to true to hash the contents that the front end read from each file
+ */
+static std::vector<IncludeDependency> DescribeIncludes(const std::vector<IncludedFile>& includedFiles, bool withHashes) {
+	std::vector<IncludeDependency> includes;
+	includes.reserve(includedFiles.size());
+	for (const auto& file : includedFiles) {
+		IncludeDependency include{file.path};
+		if (withHashes) {
+			Sha256 hash;
+			hash.Update(file.file->Contents());
+			include.contentHash = Sha256::ToHex(hash.Finish());
+		}
+		includes.push_back(std::move(include));
+	}
+	return includes;
+}
+
+static CompileResult CompileInputTo(TranspilerState& state, const PipelineContext& parentCtx, const SourceInput& input, TargetAPI api, const Options& opt, FrontEndSlot& slot) {
+	const auto start = std::chrono::steady_clock::now();
+	const auto lockWaitBefore = ThreadLockWait();
+	// the pass report and statistics describe this call only, so they are added after the result is cached
+	std::vector<OptimizerPassStats> optimizerPasses;
+	CompileStats stats;
+	PipelineContext ctx = parentCtx;
+	if (opt.reportOptimizerPasses) {
+		ctx.optimizerPasses = &optimizerPasses;
+	}
+	std::optional<MemoryProbe> memory;
+	if (opt.collectStats) {
+		ctx.stats = &stats;
+		memory.emplace();
+	}
+	auto trace = state.GetTrace();
+	if (trace) {
+		ctx.trace = trace.get();
+		ctx.shaderName = &input.fileName;
+	}
+	// the whole call is one trace event, failed or not
+	struct TraceCall {
+		CompileTrace* trace;
+		const SourceInput& input;
+		TargetAPI api;
+		std::chrono::steady_clock::time_point start;
+		~TraceCall() {
+			if (trace) {
+				trace->Record({input.fileName, input.fileName, api, CompileTrace::CurrentThread(), start, std::chrono::steady_clock::now()});
+			}
+		}
+	} traceCall{trace.get(), input, api, start};
+	auto finish = [&](CompileResult result) {
+		if (opt.collectStats) {
+			stats.memory = memory->Finish();
+			stats.allocationsCounted = MemoryProbe::CountsAllocations();
+			stats.inputBytes = input.source.size();
+			stats.outputBytes = result.data.sourceData.size() + result.data.binaryData.size();
+			stats.includeCount = uint32_t(result.includes.size());
+			stats.total = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+			stats.lockWait = ThreadLockWait() - lockWaitBefore;
+			result.stats = stats;
+		}
+		result.optimizerPasses = std::move(optimizerPasses);
+		return result;
+	};
+
+	auto memoryCache = state.GetMemoryCache();
+	auto diskCache = state.GetDiskCache();
+	Sha256::digest_t cacheKey;
+	if (memoryCache || diskCache) {
+		cacheKey = ComputeCacheKey(input, api, opt);
+	}
+	if (memoryCache) {
+		if (auto cached = memoryCache->results.Find(cacheKey)) {
+			stats.cached = true;
+			return finish(*cached);
+		}
+	}
+	if (diskCache) {
+		std::vector<IncludedFile> includes;
+		if (auto cached = diskCache->Load(cacheKey, &includes)) {
+			if (memoryCache) {
+				if (auto stamps = StampIncludes(includes)) {
+					memoryCache->results.Insert(cacheKey, std::make_shared<const CompileResult>(*cached), estimateSize(*cached), std::move(*stamps));
+				}
+			}
+			stats.cached = true;
+			return finish(std::move(*cached));
+		}
+	}
+
+	auto types = ShaderStageToInternal(input.stage);
 
 	//generate spirv
-	bool noPushConstants = api == TargetAPI::WGSL;
-	auto spirv = CompileGLSLFromFile(task, types.type, opt.debug, opt.enableInclude, noPushConstants, opt.preambleContent);
-	auto compres = CompileSpirVTo(spirv.spirvdata, api, opt, types);
-	compres.data.uniformData = std::move(spirv.uniforms);
-	compres.data.attributeData = std::move(spirv.attributes);
-	return compres;
+	if (!slot.glsl) {
+		slot.glsl = RunFrontEnd(state, ctx, input, types, opt);
+		slot.module = std::make_unique<SpirvModule>(std::shared_ptr<const spirvbytes>(slot.glsl, &slot.glsl->spirvdata));
+	}
+	const auto& spirv = slot.glsl;
+	ctx.pushConstants = &spirv->pushConstants;
+	stats.spirvWords = spirv->spirvdata.size();
+	CompileResult compres{ RunBackend(ctx, *slot.module, api, opt, types) };
+	ctx.checkpoint("backend");
+	compres.data.uniformData = spirv->uniforms;
+	compres.data.attributeData = spirv->attributes;
+	compres.includes = DescribeIncludes(spirv->includes, opt.hashIncludes);
+
+	if (diskCache) {
+		diskCache->Store(cacheKey, spirv->includes, compres);
+	}
+	if (memoryCache) {
+		if (auto stamps = StampIncludes(spirv->includes)) {
+			memoryCache->results.Insert(cacheKey, std::make_shared<const CompileResult>(compres), estimateSize(compres), std::move(*stamps));
+		}
+	}
+	return finish(std::move(compres));
+}
+
+static CompileResult CompileTaskTo(TranspilerState& state, const PipelineContext& ctx, const SourceInput& input, TargetAPI api, const Options& opt) {
+	FrontEndSlot slot;
+	return CompileInputTo(state, ctx, input, api, opt, slot);
+}
+
+static std::vector<CompileResult> CompileTaskToMany(TranspilerState& state, const PipelineContext& ctx, const SourceInput& input, const std::vector<TargetAPI>& apis, const Options& opt) {
+	FrontEndSlot slot;
+	std::vector<CompileResult> results;
+	results.reserve(apis.size());
+	for (const auto api : apis) {
+		results.push_back(CompileInputTo(state, ctx, input, api, opt, slot));
+	}
+	return results;
+}
+
+ShaderTranspiler::ShaderTranspiler() : state(std::make_shared<TranspilerState>()) {}
+
+void ShaderTranspiler::SetDiskCache(const std::filesystem::path& directory, uint64_t maxBytes) {
+	state->SetDiskCache(directory.empty() ? nullptr : std::make_shared<DiskCache>(directory, maxBytes));
+}
+
+void ShaderTranspiler::EnableMemoryCache(size_t maxBytes) {
+	state->SetMemoryCache(maxBytes == 0 ? nullptr : std::make_shared<MemoryCache>(maxBytes));
+}
+
+void ShaderTranspiler::SetTrace(std::shared_ptr<CompileTrace> trace) {
+	state->SetTrace(std::move(trace));
+}
+
+MemoryCacheStatistics ShaderTranspiler::GetMemoryCacheStatistics() const {
+	MemoryCacheStatistics stats;
+	if (auto memoryCache = state->GetMemoryCache()) {
+		stats.spirv = memoryCache->spirv.Counters();
+		stats.results = memoryCache->results.Counters();
+	}
+	return stats;
+}
+
+CompileResult ShaderTranspiler::CompileTo(const FileCompileTask& task, TargetAPI api, const Options& opt) {
+	return CompileTaskTo(*state, {}, LoadTask(task), api, opt);
 }
 
 CompileResult ShaderTranspiler::CompileTo(const MemoryCompileTask& task, TargetAPI api, const Options& opt) {
-	bool noPushConstants = api == TargetAPI::WGSL;
-	auto types = ShaderStageToInternal(task.stage);
-	auto spirv = CompileGLSL(task.source, task.sourceFileName, types.type, task.includePaths, opt.debug, opt.enableInclude, opt.preambleContent, noPushConstants);
-	auto compres = CompileSpirVTo(spirv.spirvdata, api, opt, types);
-	compres.data.uniformData = std::move(spirv.uniforms);
-	compres.data.attributeData = std::move(spirv.attributes);
-	return compres;
+	return CompileTaskTo(*state, {}, LoadTask(task), api, opt);
+}
+
+std::vector<CompileResult> ShaderTranspiler::CompileToMany(const FileCompileTask& task, const std::vector<TargetAPI>& platforms, const Options& opt) {
+	return CompileTaskToMany(*state, {}, LoadTask(task), platforms, opt);
+}
+
+std::vector<CompileResult> ShaderTranspiler::CompileToMany(const MemoryCompileTask& task, const std::vector<TargetAPI>& platforms, const Options& opt) {
+	return CompileTaskToMany(*state, {}, LoadTask(task), platforms, opt);
+}
+
+/**
+ Run a compile, recording its result or error in a BatchResult
+ */
+template<typename fn_t>
+static void CaptureBatchResult(BatchResult& result, fn_t&& compile) {
+	try{
+		result.result = compile();
+		result.succeeded = true;
+	}
+	catch(std::exception& e){
+		result.error = e.what();
+	}
+	catch(...){
+		result.error = "Unknown error";
+	}
+}
+
+std::vector<BatchResult> ShaderTranspiler::CompileBatch(const std::vector<CompileJob>& jobs) {
+	std::vector<BatchResult> results(jobs.size());
+	OutputDeduplicator dedup;
+	ThreadPool::Shared().ParallelFor(jobs.size(), [&](size_t i){
+		CaptureBatchResult(results[i], [&]{
+			PipelineContext ctx{.dedup = &dedup, .jobId = i};
+			return std::visit([&](const auto& task){
+				return CompileTaskTo(*state, ctx, LoadTask(task), jobs[i].platform, jobs[i].options);
+			}, jobs[i].task);
+		});
+		results[i].duplicateOf = dedup.DuplicateOf(i);
+	});
+	return results;
+}
+
+/**
+ Append the #defines for a variant to the preamble
+ @param preamble the user's preamble
+ @param defines the define axes, as NAME or NAME=VALUE
+ @param mask the variant. Bit i enables defines[i].
+ */
+static std::string VariantPreamble(const std::string& preamble, const std::vector<std::string>& defines, uint64_t mask) {
+	std::string result = preamble;
+	for (size_t i = 0; i < defines.size(); i++) {
+		if (mask & (uint64_t(1) << i)) {
+			auto define = defines[i];
+			if (auto equals = define.find('='); equals != std::string::npos) {
+				define[equals] = ' ';
+			}
+			result += "\n#define " + define + "\n";
+		}
+	}
+	return result;
+}
+
+template<typename task_t>
+static std::map<uint64_t, BatchResult> CompileTaskVariants(TranspilerState& state, const task_t& task, TargetAPI api, const Options& opt, const std::vector<std::string>& defines, std::vector<uint64_t> masks) {
+	if (defines.size() > 64) {
+		throw std::runtime_error("Too many define axes: " + std::to_string(defines.size()) + ", the maximum is 64");
+	}
+	if (masks.empty()) {
+		// every combination
+		if (defines.size() >= 32) {
+			throw std::runtime_error("Too many define axes to compile every combination, pass an explicit list of variants");
+		}
+		masks.resize(size_t(1) << defines.size());
+		for (size_t i = 0; i < masks.size(); i++) {
+			masks[i] = i;
+		}
+	}
+
+	// load once, all variants share the source
+	const auto input = LoadTask(task);
+	std::vector<BatchResult> results(masks.size());
+	OutputDeduplicator dedup;
+	ThreadPool::Shared().ParallelFor(masks.size(), [&](size_t i){
+		CaptureBatchResult(results[i], [&]{
+			Options variantOpt = opt;
+			variantOpt.preambleContent = VariantPreamble(opt.preambleContent, defines, masks[i]);
+			PipelineContext ctx{.dedup = &dedup, .jobId = masks[i]};
+			return CompileTaskTo(state, ctx, input, api, variantOpt);
+		});
+		results[i].duplicateOf = dedup.DuplicateOf(masks[i]);
+	});
+
+	std::map<uint64_t, BatchResult> variants;
+	for (size_t i = 0; i < masks.size(); i++) {
+		variants.insert_or_assign(masks[i], std::move(results[i]));
+	}
+	return variants;
+}
+
+std::map<uint64_t, BatchResult> ShaderTranspiler::CompileVariants(const FileCompileTask& task, TargetAPI api, const Options& opt, const std::vector<std::string>& defines, const std::vector<uint64_t>& variants) {
+	return CompileTaskVariants(*state, task, api, opt, defines, variants);
+}
+
+std::map<uint64_t, BatchResult> ShaderTranspiler::CompileVariants(const MemoryCompileTask& task, TargetAPI api, const Options& opt, const std::vector<std::string>& defines, const std::vector<uint64_t>& variants) {
+	return CompileTaskVariants(*state, task, api, opt, defines, variants);
+}
+
+void ShaderTranspiler::WarmUp(const std::vector<ShaderStage>& stages, const std::vector<uint32_t>& glslVersions) {
+	const size_t count = stages.size() * glslVersions.size();
+	ThreadPool::Shared().ParallelFor(count, [&](size_t i){
+		const auto stage = stages[i % stages.size()];
+		const auto version = glslVersions[i / stages.size()];
+		const auto type = ShaderStageToInternal(stage).type;
+
+		// glslang builds the built-in symbol tables for a version while parsing the #version line.
+		// The shader itself does not matter, and any errors in it are irrelevant.
+		const bool es = version == 100 || version == 300 || version == 310 || version == 320;
+		const std::string source = "#version " + std::to_string(version) + (es ? " es" : "") + "\nvoid main(){}\n";
+		const char* strings[] = { source.c_str() };
+
+		glslang::TShader shader(type);
+		shader.setStrings(strings, 1);
+		configureShaderEnvironment(shader, type);
+		shader.parse(&CompileContext::ForThread().Resources(), ClientInputSemanticsVersion, ECoreProfile, false, false, glslangMessages);
+	});
+}
+
+/**
+ Run a compile on the library's thread pool
+ @param makeTask creates the task to compile. Called on the worker thread.
+ */
+template<typename fn_t>
+static CompileHandle CompileAsync(std::shared_ptr<TranspilerState> state, fn_t&& makeTask, TargetAPI api, const Options& opt) {
+	CompileHandle handle;
+	auto promise = std::make_shared<std::promise<CompileResult>>();
+	handle.result = promise->get_future();
+	ThreadPool::Shared().Submit([state = std::move(state), promise, makeTask = std::forward<fn_t>(makeTask), api, opt, cancelled = handle.cancelled]{
+		try{
+			PipelineContext ctx{.cancelled = cancelled.get()};
+			ctx.checkpoint("scheduling");
+			promise->set_value(CompileTaskTo(*state, ctx, LoadTask(makeTask()), api, opt));
+		}
+		catch(...){
+			promise->set_exception(std::current_exception());
+		}
+	});
+	return handle;
+}
+
+CompileHandle ShaderTranspiler::CompileToAsync(const FileCompileTask& task, TargetAPI api, const Options& opt) {
+	// the task refers to its filename, so keep our own copy alive for the worker
+	return CompileAsync(state, [filename = task.filename, stage = task.stage, includePaths = task.includePaths]{
+		return FileCompileTask{filename, stage, includePaths};
+	}, api, opt);
+}
+
+CompileHandle ShaderTranspiler::CompileToAsync(const MemoryCompileTask& task, TargetAPI api, const Options& opt) {
+	return CompileAsync(state, [task]{
+		return task;
+	}, api, opt);
 }
 
 shadert::ShaderTranspiler::~ShaderTranspiler()
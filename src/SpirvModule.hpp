@@ -0,0 +1,86 @@
+#pragma once
+#include <ShaderTranspiler.hpp>
+#include "Reflection.hpp"
+#include "LockTiming.hpp"
+#include <spirv_parser.hpp>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace shadert{
+
+/**
+ A SPIR-V module and the data every backend derives from it. Each piece is computed at most once,
+ no matter how many backends consume the module.
+ */
+class SpirvModule{
+public:
+	/**
+	 @param spirv the module. Backends that output SPIR-V share this storage rather than copying it.
+	 */
+	explicit SpirvModule(std::shared_ptr<const spirvbytes> spirv) : storage(std::move(spirv)), spirv(*storage){}
+
+	SpirvModule(const SpirvModule&) = delete;
+	SpirvModule& operator=(const SpirvModule&) = delete;
+
+	const spirvbytes& Bytes() const{
+		return spirv;
+	}
+
+	/**
+	 @return the module as a BinaryBuffer that shares its storage
+	 */
+	BinaryBuffer Binary() const{
+		return BinaryBuffer(storage, spirv.data(), spirv.size() * sizeof(spirv[0]));
+	}
+
+	/**
+	 @return the module parsed by SPIRV-Cross. Backends construct their compiler from a copy of this.
+	 */
+	const spirv_cross::ParsedIR& IR() const{
+		std::call_once(irFlag, [this]{
+			spirv_cross::Parser parser(spirv.data(), spirv.size());
+			parser.parse();
+			ir = std::move(parser.get_parsed_ir());
+		});
+		return ir;
+	}
+
+	/**
+	 @return the reflection data for the module
+	 */
+	const ReflectData& Reflection() const{
+		std::call_once(reflectionFlag, [this]{
+			reflection = ReflectSPIRV(spirv);
+		});
+		return reflection;
+	}
+
+	/**
+	 @param key identifies the optimization, such as the level and passes
+	 @param optimize returns the optimized spirvbytes. Called at most once per key.
+	 @return the optimized module, which lives as long as this one
+	 */
+	template<typename fn_t>
+	const SpirvModule& Optimized(const std::string& key, fn_t&& optimize) const{
+		// held while optimizing, so that concurrent requests for the same key wait for the first
+		TimedLock lock(optimizedMtx);
+		auto& optimized = optimizedModules[key];
+		if (!optimized){
+			optimized = std::make_unique<SpirvModule>(std::make_shared<const spirvbytes>(optimize()));
+		}
+		return *optimized;
+	}
+
+private:
+	std::shared_ptr<const spirvbytes> storage;
+	const spirvbytes& spirv;
+	mutable std::once_flag irFlag, reflectionFlag;
+	mutable spirv_cross::ParsedIR ir;
+	mutable ReflectData reflection;
+	mutable std::mutex optimizedMtx;
+	mutable std::map<std::string, std::unique_ptr<SpirvModule>> optimizedModules;
+};
+
+}
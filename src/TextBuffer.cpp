@@ -0,0 +1,15 @@
+#include <ShaderTranspiler.hpp>
+#include <ostream>
+
+namespace shadert{
+
+const std::string& TextBuffer::EmptyString(){
+	static const std::string empty;
+	return empty;
+}
+
+std::ostream& operator<<(std::ostream& stream, const TextBuffer& buffer){
+	return stream << buffer.str();
+}
+
+}
@@ -0,0 +1,146 @@
+#include "ThreadPool.hpp"
+#include "LockTiming.hpp"
+#include <algorithm>
+#include <latch>
+
+using namespace shadert;
+
+static thread_local const ThreadPool* currentPool = nullptr;
+static thread_local size_t currentWorker = 0;
+
+ThreadPool::ThreadPool(unsigned numThreads){
+	if (numThreads == 0){
+		numThreads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	queues.reserve(numThreads);
+	for(unsigned i = 0; i < numThreads; i++){
+		queues.push_back(std::make_unique<WorkQueue>());
+	}
+	threads.reserve(numThreads);
+	for(unsigned i = 0; i < numThreads; i++){
+		threads.emplace_back([this,i]{
+			workerLoop(i);
+		});
+	}
+}
+
+ThreadPool::~ThreadPool(){
+	{
+		std::lock_guard lock(sleepMtx);
+		stopping = true;
+	}
+	sleepCV.notify_all();
+	for(auto& thread : threads){
+		thread.join();
+	}
+}
+
+void ThreadPool::Submit(job_t job){
+	// workers push onto their own queue, everyone else distributes round-robin
+	const size_t index = IsWorkerThread() ? currentWorker : nextQueue++ % queues.size();
+	{
+		auto& queue = *queues[index];
+		TimedLock lock(queue.mtx);
+		queue.jobs.push_back(std::move(job));
+	}
+	bool wakeSearchers;
+	{
+		std::lock_guard lock(sleepMtx);
+		pending++;
+		submitted++;
+		wakeSearchers = searching > 0;
+	}
+	sleepCV.notify_one();
+	if (wakeSearchers){
+		searchCV.notify_all();
+	}
+}
+
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t)>& fn){
+	if (count == 0){
+		return;
+	}
+	if (IsWorkerThread() || count == 1){
+		for(size_t i = 0; i < count; i++){
+			fn(i);
+		}
+		return;
+	}
+	std::latch done(count);
+	for(size_t i = 0; i < count; i++){
+		Submit([&fn,&done,i]{
+			fn(i);
+			done.count_down();
+		});
+	}
+	done.wait();
+}
+
+bool ThreadPool::IsWorkerThread() const{
+	return currentPool == this;
+}
+
+bool ThreadPool::tryPop(size_t index, job_t& out){
+	// the owner takes the newest job
+	auto& queue = *queues[index];
+	TimedLock lock(queue.mtx);
+	if (queue.jobs.empty()){
+		return false;
+	}
+	out = std::move(queue.jobs.back());
+	queue.jobs.pop_back();
+	return true;
+}
+
+bool ThreadPool::trySteal(size_t thief, job_t& out){
+	// thieves take the oldest job from the other queues
+	for(size_t offset = 1; offset < queues.size(); offset++){
+		auto& queue = *queues[(thief + offset) % queues.size()];
+		TimedLock lock(queue.mtx);
+		if (!queue.jobs.empty()){
+			out = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+			return true;
+		}
+	}
+	return false;
+}
+
+void ThreadPool::workerLoop(size_t index){
+	currentPool = this;
+	currentWorker = index;
+	while(true){
+		uint64_t seen;
+		{
+			std::unique_lock lock(sleepMtx);
+			sleepCV.wait(lock, [this]{
+				return stopping || pending > 0;
+			});
+			if (pending == 0){
+				// stopping and nothing left to do
+				return;
+			}
+			pending--;
+			seen = submitted;
+		}
+		// a job is reserved for us, find it. A search can only come up empty if another worker took the job we would
+		// have found, and then a job submitted after the search started is still waiting. Sleep until that Submit has
+		// finished instead of spinning.
+		job_t job;
+		while(!tryPop(index, job) && !trySteal(index, job)){
+			std::unique_lock lock(sleepMtx);
+			searching++;
+			searchCV.wait(lock, [this, seen]{
+				return submitted != seen;
+			});
+			searching--;
+			seen = submitted;
+		}
+		job();
+	}
+}
+
+ThreadPool& ThreadPool::Shared(){
+	static ThreadPool pool;
+	return pool;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace shadert{
+
+/**
+ A work-stealing thread pool. Every worker owns a queue; jobs submitted from outside the pool are spread
+ round-robin across the queues, and idle workers steal from the other queues.
+ */
+class ThreadPool{
+public:
+	using job_t = std::function<void()>;
+
+	/**
+	 @param numThreads the number of workers to create. 0 uses the hardware concurrency.
+	 */
+	explicit ThreadPool(unsigned numThreads = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	/**
+	 Queue a job. When called from one of this pool's workers, the job goes on that worker's own queue.
+	 */
+	void Submit(job_t job);
+
+	/**
+	 Run fn(i) for every i in [0, count) on the pool and block until all have completed.
+	 If called from a worker of this pool, the jobs are run inline to avoid waiting on ourselves.
+	 fn must not throw.
+	 */
+	void ParallelFor(size_t count, const std::function<void(size_t)>& fn);
+
+	/**
+	 @return true if the calling thread is a worker of this pool
+	 */
+	bool IsWorkerThread() const;
+
+	size_t NumThreads() const{
+		return threads.size();
+	}
+
+	/**
+	 @return the process-wide pool used by the library, sized to the hardware
+	 */
+	static ThreadPool& Shared();
+
+private:
+	struct WorkQueue{
+		std::mutex mtx;
+		std::deque<job_t> jobs;
+	};
+
+	bool tryPop(size_t index, job_t& out);
+	bool trySteal(size_t thief, job_t& out);
+	void workerLoop(size_t index);
+
+	std::vector<std::unique_ptr<WorkQueue>> queues;
+	std::vector<std::thread> threads;
+	std::atomic<size_t> nextQueue = 0;
+	size_t pending = 0;			// submitted jobs no worker has reserved yet
+	uint64_t submitted = 0;		// jobs submitted so far
+	size_t searching = 0;		// workers waiting for a job to reach the queues
+	std::mutex sleepMtx;
+	std::condition_variable sleepCV;
+	std::condition_variable searchCV;
+	bool stopping = false;
+};
+
+}
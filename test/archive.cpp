@@ -0,0 +1,397 @@
+// ShaderArchive tests, run by ctest
+#include <ShaderTranspiler/ShaderTranspiler.hpp>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace shadert;
+namespace fs = std::filesystem;
+
+static int failures = 0;
+
+static void check(bool condition, const string& what){
+	if (!condition){
+		cerr << "failed: " << what << endl;
+		failures++;
+	}
+}
+
+static const char* lightingInclude = R"(
+	vec3 shade(vec3 normal, vec3 albedo){
+		return albedo * max(dot(normal, normalize(vec3(1, 2, 3))), 0.1);
+	}
+)";
+
+static const char* fragmentShader = R"(#version 460
+	#include "lighting.glsl"
+	layout(location = 0) in vec3 worldNormal;
+	layout(location = 1) in vec2 uv;
+	layout(location = 0) out vec4 color;
+	layout(binding = 0) uniform Material{
+		vec4 tint;
+		float roughness;
+	};
+	layout(binding = 1) uniform sampler2D albedo;
+	void main(){
+		color = vec4(shade(worldNormal, texture(albedo, uv).rgb), 1) * tint * roughness;
+	}
+)";
+
+static const char* vertexShader = R"(#version 460
+	layout(location = 0) in vec3 position;
+	layout(location = 1) in vec3 normal;
+	layout(location = 0) out vec3 worldNormal;
+	layout(binding = 0) uniform Frame{
+		mat4 viewProj;
+	};
+	void main(){
+		worldNormal = normal;
+		gl_Position = viewProj * vec4(position, 1);
+	}
+)";
+
+static const char* computeShader = R"(#version 460
+	layout(local_size_x = 8, local_size_y = 4) in;
+	layout(std430, binding = 0) buffer Values{
+		float values[];
+	};
+	void main(){
+		values[gl_GlobalInvocationID.x] *= 2.0;
+	}
+)";
+
+/**
+ A directory that is removed when the test ends
+ */
+struct TempDirectory{
+	fs::path path;
+	TempDirectory(){
+		path = fs::temp_directory_path() / ("shadert_archive_test_" + to_string(random_device()()));
+		fs::create_directories(path);
+	}
+	~TempDirectory(){
+		error_code ec;
+		fs::remove_all(path, ec);
+	}
+};
+
+/**
+ @return the bytes copied to 8-byte aligned storage, as FromBytes requires
+ */
+static vector<uint64_t> aligned(string_view bytes){
+	vector<uint64_t> storage((bytes.size() + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+	if (!bytes.empty()){
+		memcpy(storage.data(), bytes.data(), bytes.size());
+	}
+	return storage;
+}
+
+static string_view view(const vector<uint64_t>& storage, size_t size){
+	return {reinterpret_cast<const char*>(storage.data()), size};
+}
+
+static void checkSameResources(const vector<ReflectData::Resource>& a, const vector<ReflectData::Resource>& b, const string& what){
+	check(a.size() == b.size(), what + " count");
+	for (size_t i = 0; i < min(a.size(), b.size()); i++){
+		check(a[i].id == b[i].id && a[i].type_id == b[i].type_id && a[i].base_type_id == b[i].base_type_id && a[i].name == b[i].name
+			&& a[i].set == b[i].set && a[i].binding == b[i].binding && a[i].location == b[i].location
+			&& a[i].samplerBinding == b[i].samplerBinding, what + " " + to_string(i));
+	}
+}
+
+static void checkSameResult(const CompileResult& a, const CompileResult& b, const string& what){
+	check(a.data.sourceData == b.data.sourceData, what + ": source");
+	check(a.data.binaryData.Bytes() == b.data.binaryData.Bytes(), what + ": binary");
+
+	const auto& ra = a.data.reflectData;
+	const auto& rb = b.data.reflectData;
+	checkSameResources(ra.uniform_buffers, rb.uniform_buffers, what + ": uniform buffer");
+	checkSameResources(ra.storage_buffers, rb.storage_buffers, what + ": storage buffer");
+	checkSameResources(ra.stage_inputs, rb.stage_inputs, what + ": stage input");
+	checkSameResources(ra.stage_outputs, rb.stage_outputs, what + ": stage output");
+	checkSameResources(ra.sampled_images, rb.sampled_images, what + ": sampled image");
+	checkSameResources(ra.push_constant_buffers, rb.push_constant_buffers, what + ": push constant buffer");
+	check(ra.compute_dim == rb.compute_dim, what + ": compute dimensions");
+
+	check(a.data.uniformData.size() == b.data.uniformData.size(), what + ": uniform count");
+	for (size_t i = 0; i < min(a.data.uniformData.size(), b.data.uniformData.size()); i++){
+		const auto& ua = a.data.uniformData[i];
+		const auto& ub = b.data.uniformData[i];
+		check(ua.name == ub.name && ua.glDefineType == ub.glDefineType && ua.arraySize == ub.arraySize && ua.bufferOffset == ub.bufferOffset
+			&& ua.texComponent == ub.texComponent && ua.texDimension == ub.texDimension && ua.texFormat == ub.texFormat,
+			what + ": uniform " + ua.name);
+	}
+	check(a.data.attributeData.size() == b.data.attributeData.size(), what + ": attribute count");
+	for (size_t i = 0; i < min(a.data.attributeData.size(), b.data.attributeData.size()); i++){
+		check(a.data.attributeData[i].name == b.data.attributeData[i].name, what + ": attribute " + to_string(i));
+	}
+	check(a.includes.size() == b.includes.size(), what + ": include count");
+	for (size_t i = 0; i < min(a.includes.size(), b.includes.size()); i++){
+		check(a.includes[i].path == b.includes[i].path && a.includes[i].contentHash == b.includes[i].contentHash, what + ": include " + to_string(i));
+	}
+}
+
+struct Entry{
+	string key;
+	CompileResult result;
+};
+
+/**
+ @return results for several stages and targets, with reflection, uniforms, attributes and includes
+ */
+static vector<Entry> compileEntries(const fs::path& directory){
+	ofstream(directory / "lighting.glsl") << lightingInclude;
+
+	Options opt;
+	opt.entryPoint = "main";
+	opt.enableInclude = true;
+	opt.hashIncludes = true;
+	ShaderTranspiler transpiler;
+	const MemoryCompileTask fragment{fragmentShader, "material.frag", ShaderStage::Fragment, {directory}};
+
+	vector<Entry> entries;
+	opt.version = 16;
+	entries.push_back({"material.frag/vulkan", transpiler.CompileTo(fragment, TargetAPI::Vulkan, opt)});
+	entries.push_back({"frame.vert/vulkan", transpiler.CompileTo(MemoryCompileTask{vertexShader, "frame.vert", ShaderStage::Vertex}, TargetAPI::Vulkan, opt)});
+	entries.push_back({"values.comp/vulkan", transpiler.CompileTo(MemoryCompileTask{computeShader, "values.comp", ShaderStage::Compute}, TargetAPI::Vulkan, opt)});
+	opt.version = 410;
+	entries.push_back({"material.frag/opengl", transpiler.CompileTo(fragment, TargetAPI::OpenGL, opt)});
+	opt.version = 30;
+	entries.push_back({"material.frag/metal", transpiler.CompileTo(fragment, TargetAPI::Metal, opt)});
+	return entries;
+}
+
+static string writeArchive(const vector<Entry>& entries){
+	ShaderArchiveWriter writer;
+	for (const auto& entry : entries){
+		writer.Add(entry.key, entry.result);
+	}
+	return writer.Finish();
+}
+
+/**
+ Store results, read them back from memory and from a file, and compare every field
+ */
+static int roundTrip(){
+	TempDirectory directory;
+	const auto entries = compileEntries(directory.path);
+	check(!entries[0].result.includes.empty() && !entries[0].result.includes[0].contentHash.empty(), "the fragment shader records its include");
+	check(!entries[0].result.data.uniformData.empty(), "the fragment shader has uniforms");
+	check(!entries[1].result.data.attributeData.empty(), "the vertex shader has attributes");
+	check(!entries[3].result.data.sourceData.empty(), "the OpenGL result has source");
+
+	const auto bytes = writeArchive(entries);
+	const auto storage = aligned(bytes);
+	const auto archive = ShaderArchive::FromBytes(view(storage, bytes.size()));
+	check(archive.Size() == entries.size(), "entry count");
+	for (size_t i = 0; i < min(archive.Size(), entries.size()); i++){
+		check(archive.Key(i) == entries[i].key, "key " + to_string(i));
+		const auto shader = archive.At(i);
+		check(shader.SourceData() == entries[i].result.data.sourceData, entries[i].key + ": source view");
+		check(shader.BinaryData() == entries[i].result.data.binaryData.Bytes(), entries[i].key + ": binary view");
+		checkSameResult(shader.ToCompileResult(), entries[i].result, entries[i].key);
+	}
+	const auto words = archive.At(0).SpirvWords();
+	check(!words.empty() && words[0] == 0x07230203, "the Vulkan result reads as SPIR-V in place");
+
+	const auto file = directory.path / "shaders.star";
+	ShaderArchiveWriter writer;
+	for (const auto& entry : entries){
+		writer.Add(entry.key, entry.result);
+	}
+	writer.Write(file);
+	const auto opened = ShaderArchive::Open(file);
+	check(opened.Size() == entries.size(), "entry count after Open");
+	for (size_t i = 0; i < min(opened.Size(), entries.size()); i++){
+		checkSameResult(opened.At(i).ToCompileResult(), entries[i].result, entries[i].key + " from file");
+	}
+
+	// an empty result and an empty archive
+	const auto empty = writeArchive({{"empty", CompileResult{}}});
+	const auto emptyStorage = aligned(empty);
+	checkSameResult(ShaderArchive::FromBytes(view(emptyStorage, empty.size())).At(0).ToCompileResult(), CompileResult{}, "empty result");
+	const auto none = ShaderArchiveWriter().Finish();
+	const auto noneStorage = aligned(none);
+	const auto noArchive = ShaderArchive::FromBytes(view(noneStorage, none.size()));
+	check(noArchive.Size() == 0 && !noArchive.Find("anything"), "empty archive");
+	return failures > 0;
+}
+
+/**
+ Find every key of an archive with many entries, and fail to find keys that are not in it
+ */
+static int lookup(){
+	TempDirectory directory;
+	const auto compiled = compileEntries(directory.path);
+	vector<Entry> entries;
+	for (size_t i = 0; i < 200; i++){
+		entries.push_back({"shader" + to_string(i), compiled[i % compiled.size()].result});
+	}
+	const auto bytes = writeArchive(entries);
+	const auto storage = aligned(bytes);
+	const auto archive = ShaderArchive::FromBytes(view(storage, bytes.size()));
+	check(archive.Size() == entries.size(), "entry count");
+	for (size_t i = 0; i < entries.size(); i++){
+		const auto found = archive.Find(entries[i].key);
+		check(found.has_value(), "find " + entries[i].key);
+		if (found){
+			check(found->SourceData() == entries[i].result.data.sourceData && found->BinaryData() == entries[i].result.data.binaryData.Bytes(),
+				"find " + entries[i].key + " returns its own result");
+		}
+	}
+	for (const auto& missing : {"", "shader", "shader200", "shader-1", "Shader0", "shader0 ", "material.frag/vulkan"}){
+		check(!archive.Find(missing), string("no result for \"") + missing + "\"");
+	}
+
+	bool threw = false;
+	try{
+		archive.At(archive.Size());
+	}
+	catch(out_of_range&){
+		threw = true;
+	}
+	check(threw, "At past the end throws");
+	return failures > 0;
+}
+
+/**
+ Read every part of an archive that opened. Anything it returns must lie inside the archive's bytes.
+ */
+static void readEverything(string_view bytes, const ShaderArchive& archive){
+	const auto inside = [&](string_view part){
+		return part.empty() || (part.data() >= bytes.data() && part.data() + part.size() <= bytes.data() + bytes.size());
+	};
+	for (size_t i = 0; i < archive.Size(); i++){
+		try{
+			check(inside(archive.Key(i)), "key inside the archive");
+			archive.Find(archive.Key(i));
+			const auto shader = archive.At(i);
+			check(inside(shader.SourceData()) && inside(shader.BinaryData()), "sections inside the archive");
+			for (size_t u = 0; u < shader.UniformCount(); u++){
+				check(inside(shader.Uniform(u).name), "uniform name inside the archive");
+			}
+			for (size_t a = 0; a < shader.AttributeCount(); a++){
+				check(inside(shader.Attribute(a)), "attribute inside the archive");
+			}
+			for (size_t n = 0; n < shader.IncludeCount(); n++){
+				check(inside(shader.IncludePath(n)) && inside(shader.IncludeHash(n)), "include inside the archive");
+			}
+			const auto& reflection = shader.Reflection();
+			for (size_t type = 0; type < size_t(ReflectionView::ResourceType::Count); type++){
+				const auto resourceType = ReflectionView::ResourceType(type);
+				for (size_t r = 0; r < reflection.Size(resourceType); r++){
+					check(inside(reflection.Name(resourceType, r)), "resource name inside the archive");
+				}
+			}
+			shader.ToCompileResult();
+		}
+		catch(exception&){
+			// a damaged entry may throw, as long as it does not read outside the archive
+		}
+	}
+}
+
+/**
+ Truncated archives and garbage must throw when opened. Damaged archives may open, but must not read out of bounds.
+ */
+static int corrupt(){
+	TempDirectory directory;
+	const auto bytes = writeArchive(compileEntries(directory.path));
+
+	// every truncation loses part of the hash index at the end, which is checked when the archive is opened
+	for (size_t size = 0; size < bytes.size(); size++){
+		const auto storage = aligned(bytes.substr(0, size));
+		bool threw = false;
+		try{
+			ShaderArchive::FromBytes(view(storage, size));
+		}
+		catch(exception&){
+			threw = true;
+		}
+		if (!threw){
+			check(false, "archive truncated to " + to_string(size) + " of " + to_string(bytes.size()) + " bytes throws");
+			break;
+		}
+	}
+
+	// a truncated file
+	const auto file = directory.path / "truncated.star";
+	ofstream(file, ios::binary).write(bytes.data(), bytes.size() / 2);
+	bool threw = false;
+	try{
+		ShaderArchive::Open(file);
+	}
+	catch(exception&){
+		threw = true;
+	}
+	check(threw, "opening a truncated file throws");
+	threw = false;
+	try{
+		ShaderArchive::Open(directory.path / "missing.star");
+	}
+	catch(exception&){
+		threw = true;
+	}
+	check(threw, "opening a missing file throws");
+
+	mt19937_64 random(1234);
+	for (size_t attempt = 0; attempt < 1000; attempt++){
+		string garbage(random() % 4096, '\0');
+		for (auto& c : garbage){
+			c = char(random());
+		}
+		const auto storage = aligned(garbage);
+		threw = false;
+		try{
+			ShaderArchive::FromBytes(view(storage, garbage.size()));
+		}
+		catch(exception&){
+			threw = true;
+		}
+		if (!threw){
+			check(false, "garbage of " + to_string(garbage.size()) + " bytes throws");
+			break;
+		}
+	}
+
+	// valid headers with damaged contents: overwrite random bytes, including offsets and sizes
+	for (size_t attempt = 0; attempt < 2000; attempt++){
+		auto damaged = bytes;
+		const size_t count = 1 + random() % 8;
+		for (size_t i = 0; i < count; i++){
+			damaged[random() % damaged.size()] = char(random());
+		}
+		const auto storage = aligned(damaged);
+		const auto bytesView = view(storage, damaged.size());
+		try{
+			readEverything(bytesView, ShaderArchive::FromBytes(bytesView));
+		}
+		catch(exception&){
+		}
+	}
+	return failures > 0;
+}
+
+int main(int argc, char** argv){
+	try{
+		if (argc == 2 && strcmp(argv[1], "round-trip") == 0){
+			return roundTrip();
+		}
+		if (argc == 2 && strcmp(argv[1], "lookup") == 0){
+			return lookup();
+		}
+		if (argc == 2 && strcmp(argv[1], "corrupt") == 0){
+			return corrupt();
+		}
+	}
+	catch(exception& e){
+		cerr << e.what() << endl;
+		return 1;
+	}
+	cerr << "usage: " << argv[0] << " round-trip|lookup|corrupt" << endl;
+	return 2;
+}
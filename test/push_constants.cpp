@@ -0,0 +1,177 @@
+// Push constant lowering tests, run by ctest. LowerPushConstants is called directly, so WGSL does not need to be enabled.
+#include <ShaderTranspiler/ShaderTranspiler.hpp>
+#include "PushConstantLowering.hpp"
+#include <spirv-tools/libspirv.hpp>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace shadert;
+
+static int failures = 0;
+
+static void check(bool condition, const string& what){
+	if (!condition){
+		cerr << "failed: " << what << endl;
+		failures++;
+	}
+}
+
+struct Block{
+	const char* name;
+	const char* structs;		// declared before the block
+	const char* members;
+	const char* use;			// an expression of type vec4 that reads every member, so that none are optimized out
+};
+
+// the std430 layout of these is also a valid std140 layout
+static const Block acceptedBlocks[] = {
+	{"vec4 array", "", "vec4 colors[4]; float scale;", "pc.colors[0] + pc.colors[3] * pc.scale"},
+	{"mat4", "", "mat4 model; vec4 tint;", "pc.model * pc.tint"},
+	{"struct at 16", "struct Light{ vec3 direction; float power; };", "vec2 offset; Light light;", "vec4(pc.offset, pc.light.direction.x, pc.light.power)"},
+	{"member after struct", "struct Light{ vec3 direction; float power; };", "Light light; float after;", "vec4(pc.light.direction, pc.light.power + pc.after)"},
+	{"array of structs", "struct Light{ vec3 direction; float power; };", "Light lights[2]; vec4 ambient;", "vec4(pc.lights[1].direction, pc.lights[0].power) + pc.ambient"},
+	{"scalars", "", "float a; int b; uint c; vec2 d;", "vec4(pc.a, pc.b, pc.c, pc.d.x)"},
+};
+
+struct Rejected{
+	Block block;
+	const char* member;		// the reflected name that the error must give
+	const char* reason;		// part of the error message
+};
+
+// valid push constants under std430, but not valid uniform buffers under std140
+static const Rejected rejectedBlocks[] = {
+	{{"scalar array", "", "float weights[4];", "vec4(pc.weights[0], pc.weights[1], pc.weights[2], pc.weights[3])"}, "Constants.weights", "stride of 4 bytes"},
+	{{"vec2 array", "", "vec2 points[2];", "vec4(pc.points[0], pc.points[1])"}, "Constants.points", "stride of 8 bytes"},
+	{{"struct at 8", "struct Pair{ vec2 value; };", "vec2 offset; Pair pair;", "vec4(pc.offset, pc.pair.value)"}, "Constants.pair", "multiple of 16"},
+	{{"member after struct", "struct Triple{ float x; float y; float z; };", "Triple triple; float after;", "vec4(pc.triple.x, pc.triple.y, pc.triple.z, pc.after)"},
+		"Constants.after", "inside the padding after Constants.triple"},
+	{{"mat2", "", "mat2 rotation;", "vec4(pc.rotation[0], pc.rotation[1])"}, "Constants.rotation", "matrix with a stride of 8 bytes"},
+	{{"mat2 array", "", "vec4 tint; mat2 rotations[2];", "pc.tint + vec4(pc.rotations[1][0], pc.rotations[0][1])"}, "Constants.rotations", "matrix with a stride of 8 bytes"},
+	{{"mat2 in struct", "struct Transform{ mat2 rotation; };", "vec4 tint; Transform transform;", "pc.tint + vec4(pc.transform.rotation[0], pc.transform.rotation[1])"},
+		"Constants.transform.rotation", "matrix with a stride of 8 bytes"},
+};
+
+/**
+ Compile a fragment shader with a push constant block to Vulkan SPIR-V
+ @param names receives the uniforms that the front end reflected, which include the push constant members
+ */
+static spirvbytes compile(const Block& block, bool debug, vector<PushConstantMember>& names){
+	const string source = string("#version 460\n") + block.structs + "\nlayout(push_constant) uniform Constants{ " + block.members
+		+ " } pc;\nlayout(location = 0) out vec4 color;\nvoid main(){ color = " + block.use + "; }\n";
+	Options opt;
+	opt.version = 13;
+	opt.entryPoint = "main";
+	opt.debug = debug;
+	ShaderTranspiler transpiler;
+	const auto result = transpiler.CompileTo(MemoryCompileTask{source, "push_constants.frag", ShaderStage::Fragment}, TargetAPI::Vulkan, opt);
+	names.clear();
+	for (const auto& uniform : result.data.uniformData){
+		names.push_back({uniform.name, uniform.bufferOffset});
+	}
+	const auto words = result.data.binaryData.Words();
+	return spirvbytes(words.begin(), words.end());
+}
+
+static string disassemble(const spirvbytes& spirv){
+	spvtools::SpirvTools tools(SPV_ENV_VULKAN_1_3);
+	string text;
+	tools.Disassemble(spirv, &text);
+	return text;
+}
+
+/**
+ Layouts that are valid uniform buffers must lower to modules that pass the validator
+ */
+static int accepted(){
+	spvtools::SpirvTools tools(SPV_ENV_VULKAN_1_3);
+	string messages;
+	tools.SetMessageConsumer([&](spv_message_level_t, const char*, const spv_position_t&, const char* message){
+		messages += string(message) + "\n";
+	});
+	vector<PushConstantMember> names;
+	for (const auto& block : acceptedBlocks){
+		for (const bool debug : {false, true}){
+			const string what = string(block.name) + (debug ? " (debug)" : "");
+			try{
+				const auto lowered = LowerPushConstants(compile(block, debug, names), 2, 5, &names);
+				messages.clear();
+				check(tools.Validate(lowered), what + " is valid SPIR-V after lowering: " + messages);
+				const auto text = disassemble(lowered);
+				check(text.find("PushConstant") == string::npos, what + " has no push constants left");
+				check(text.find("DescriptorSet 2") != string::npos && text.find("Binding 5") != string::npos, what + " is bound to set 2, binding 5");
+			}
+			catch(exception& e){
+				check(false, what + " threw: " + e.what());
+			}
+		}
+	}
+
+	// a module without push constants comes back unchanged
+	const Block none{"none", "", "vec4 unused;", "vec4(1)"};
+	auto spirv = compile(none, false, names);
+	check(disassemble(spirv).find("PushConstant") == string::npos, "the optimizer removes an unused block");
+	check(LowerPushConstants(spirv, 0, 0) == spirv, "a module without push constants is unchanged");
+	return failures > 0;
+}
+
+/**
+ Layouts that are not valid uniform buffers must throw, naming the member by its reflected name, index and offset
+ */
+static int rejected(){
+	vector<PushConstantMember> names;
+	for (const auto& test : rejectedBlocks){
+		for (const bool debug : {false, true}){
+			const string what = string(test.block.name) + (debug ? " (debug)" : "");
+			string error;
+			try{
+				LowerPushConstants(compile(test.block, debug, names), 0, 0, &names);
+			}
+			catch(runtime_error& e){
+				error = e.what();
+			}
+			check(!error.empty(), what + " throws");
+			if (error.empty()){
+				continue;
+			}
+			check(error.find(string("member ") + test.member + " (member ") != string::npos, what + " names " + test.member + ": " + error);
+			check(error.find("at byte offset") != string::npos, what + " gives the byte offset: " + error);
+			check(error.find(test.reason) != string::npos, what + " says " + test.reason + ": " + error);
+		}
+	}
+
+	// without the front end's names, a stripped module still reports the index and offset
+	const auto& mat2 = *find_if(begin(rejectedBlocks), end(rejectedBlocks), [](const Rejected& test){
+		return strcmp(test.block.name, "mat2") == 0;
+	});
+	string error;
+	try{
+		LowerPushConstants(compile(mat2.block, false, names), 0, 0);
+	}
+	catch(runtime_error& e){
+		error = e.what();
+	}
+	check(error.find("member 0 (member 0 at byte offset 0)") != string::npos, "an unnamed member is reported by index and offset: " + error);
+	return failures > 0;
+}
+
+int main(int argc, char** argv){
+	try{
+		if (argc == 2 && strcmp(argv[1], "accepted") == 0){
+			return accepted();
+		}
+		if (argc == 2 && strcmp(argv[1], "rejected") == 0){
+			return rejected();
+		}
+	}
+	catch(exception& e){
+		cerr << e.what() << endl;
+		return 1;
+	}
+	cerr << "usage: " << argv[0] << " accepted|rejected" << endl;
+	return 2;
+}
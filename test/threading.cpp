@@ -0,0 +1,245 @@
+// Thread-safety and scaling tests, run by ctest. scaling is only registered with ST_ENABLE_SCALING_TEST.
+#include <ShaderTranspiler/ShaderTranspiler.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace shadert;
+
+static const char* vertexShader = R"(#version 460
+	layout(location = 0) in vec3 position;
+	layout(location = 1) in vec3 normal;
+	layout(location = 0) out vec3 worldNormal;
+	layout(binding = 0) uniform Frame{
+		mat4 viewProj;
+		mat4 model;
+	};
+	void main(){
+		worldNormal = normalize(mat3(model) * normal);
+		gl_Position = viewProj * model * vec4(position, 1);
+	}
+)";
+
+static const char* fragmentShader = R"(#version 460
+	layout(location = 0) in vec3 worldNormal;
+	layout(location = 0) out vec4 color;
+	layout(binding = 1) uniform sampler2D albedo;
+	void main(){
+		float light = max(dot(worldNormal, normalize(vec3(1, 2, 3))), 0.1);
+		color = texture(albedo, worldNormal.xy) * light;
+	}
+)";
+
+static const char* computeShader = R"(#version 460
+	layout(local_size_x = 64) in;
+	layout(std430, binding = 0) buffer Values{
+		float values[];
+	};
+	void main(){
+		uint i = gl_GlobalInvocationID.x;
+		values[i] = sqrt(values[i]) * 2.0 + 1.0;
+	}
+)";
+
+struct Job{
+	MemoryCompileTask task;
+	TargetAPI api;
+	Options opt;
+};
+
+/**
+ @return a compile of each shader to each target. The targets use different glslang symbol tables.
+ */
+static vector<Job> makeJobs(bool collectStats){
+	struct Target{
+		TargetAPI api;
+		uint32_t version;
+		bool mobile;
+	};
+	const Target targets[] = {
+		{TargetAPI::Vulkan, 16, false},
+		{TargetAPI::OpenGL, 410, false},
+		{TargetAPI::OpenGL_ES, 310, true},
+		{TargetAPI::HLSL, 62, false},
+		{TargetAPI::Metal, 30, false},
+	};
+	const MemoryCompileTask tasks[] = {
+		{vertexShader, "scaling.vert", ShaderStage::Vertex},
+		{fragmentShader, "scaling.frag", ShaderStage::Fragment},
+		{computeShader, "scaling.comp", ShaderStage::Compute},
+	};
+	vector<Job> jobs;
+	for (const auto& target : targets){
+		Options opt;
+		opt.version = target.version;
+		opt.mobile = target.mobile;
+		opt.entryPoint = "main";
+		opt.collectStats = collectStats;
+		for (const auto& task : tasks){
+			jobs.push_back({task, target.api, opt});
+		}
+	}
+	return jobs;
+}
+
+/**
+ Start fn on every thread at once
+ @param fn called with the index of the thread
+ */
+template<typename fn_t>
+static void runTogether(unsigned threadCount, fn_t&& fn){
+	atomic<unsigned> waiting = threadCount;
+	vector<thread> threads;
+	for (unsigned t = 0; t < threadCount; t++){
+		threads.emplace_back([&, t]{
+			waiting--;
+			while (waiting.load() > 0){
+				this_thread::yield();
+			}
+			fn(t);
+		});
+	}
+	for (auto& thread : threads){
+		thread.join();
+	}
+}
+
+/**
+ The first compile in a process initializes glslang. Race it from many threads, each with its own ShaderTranspiler,
+ and check that every result matches the same compile run alone afterwards.
+ */
+static int initRaceChild(){
+	const auto jobs = makeJobs(false);
+	const unsigned threadCount = max(8u, thread::hardware_concurrency());
+	vector<string> outputs(threadCount);
+	atomic<int> failures = 0;
+	runTogether(threadCount, [&](unsigned t){
+		const auto& job = jobs[t % jobs.size()];
+		try{
+			ShaderTranspiler transpiler;
+			outputs[t] = transpiler.CompileTo(job.task, job.api, job.opt).data.sourceData;
+		}
+		catch(exception& e){
+			cerr << "thread " << t << " failed: " << e.what() << endl;
+			failures++;
+		}
+	});
+
+	ShaderTranspiler transpiler;
+	for (unsigned t = 0; t < threadCount; t++){
+		const auto& job = jobs[t % jobs.size()];
+		if (outputs[t] != transpiler.CompileTo(job.task, job.api, job.opt).data.sourceData){
+			cerr << "thread " << t << " produced different output for " << job.task.sourceFileName << endl;
+			failures++;
+		}
+	}
+	return failures > 0;
+}
+
+/**
+ Run initRaceChild in fresh processes, since the race only exists on first use
+ */
+static int initRace(const char* self){
+	constexpr int processes = 20;
+	const string command = string("\"") + self + "\" init-race-child";
+	for (int i = 0; i < processes; i++){
+		if (system(command.c_str()) != 0){
+			cerr << "init race failed in process " << i << endl;
+			return 1;
+		}
+	}
+	return 0;
+}
+
+static double envOr(const char* name, double fallback){
+	const char* value = getenv(name);
+	return value ? atof(value) : fallback;
+}
+
+struct Measurement{
+	double compilesPerSecond = 0;
+	double lockWaitFraction = 0;
+};
+
+static Measurement measure(ShaderTranspiler& transpiler, const vector<Job>& jobs, unsigned threadCount, size_t rounds){
+	atomic<int64_t> compileNs = 0, lockWaitNs = 0;
+	const auto start = chrono::steady_clock::now();
+	runTogether(threadCount, [&](unsigned){
+		for (size_t round = 0; round < rounds; round++){
+			for (const auto& job : jobs){
+				const auto stats = *transpiler.CompileTo(job.task, job.api, job.opt).stats;
+				compileNs += stats.total.count();
+				lockWaitNs += stats.lockWait.count();
+			}
+		}
+	});
+	const double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	return {threadCount * rounds * jobs.size() / seconds, double(lockWaitNs) / compileNs};
+}
+
+/**
+ Fail if adding threads does not add throughput, or if compiles spend a noticeable part of their time waiting on the
+ library's locks. The limits can be changed with ST_SCALING_MIN_EFFICIENCY and ST_SCALING_MAX_LOCK_WAIT.
+ */
+static int scaling(){
+	const double minEfficiency = envOr("ST_SCALING_MIN_EFFICIENCY", 0.5);
+	const double maxLockWait = envOr("ST_SCALING_MAX_LOCK_WAIT", 0.05);
+	const unsigned cores = max(1u, thread::hardware_concurrency());
+	const unsigned threadCount = clamp(cores, 2u, 4u);
+	constexpr size_t rounds = 4;
+	constexpr int attempts = 3;
+
+	ShaderTranspiler::WarmUp({ShaderStage::Vertex, ShaderStage::Fragment, ShaderStage::Compute}, {460});
+	ShaderTranspiler transpiler;
+	const auto jobs = makeJobs(true);
+	measure(transpiler, jobs, 1, 1);
+
+	// timing is noisy, so keep the best of a few attempts
+	double bestEfficiency = 0, bestLockWait = 1;
+	for (int attempt = 0; attempt < attempts; attempt++){
+		const auto single = measure(transpiler, jobs, 1, rounds);
+		const auto parallel = measure(transpiler, jobs, threadCount, rounds);
+		const double speedup = parallel.compilesPerSecond / single.compilesPerSecond;
+		const double efficiency = speedup / min(threadCount, cores);
+		cout << "threads=" << threadCount << " cores=" << cores << " speedup=" << speedup << " efficiency=" << efficiency
+			<< " lock_wait_fraction=" << parallel.lockWaitFraction << endl;
+		bestEfficiency = max(bestEfficiency, efficiency);
+		bestLockWait = min(bestLockWait, parallel.lockWaitFraction);
+	}
+	if (bestEfficiency < minEfficiency){
+		cerr << "scaling efficiency " << bestEfficiency << " is below " << minEfficiency << endl;
+		return 1;
+	}
+	if (bestLockWait > maxLockWait){
+		cerr << "lock wait fraction " << bestLockWait << " is above " << maxLockWait << endl;
+		return 1;
+	}
+	return 0;
+}
+
+int main(int argc, char** argv){
+	try{
+		if (argc == 2 && strcmp(argv[1], "init-race") == 0){
+			return initRace(argv[0]);
+		}
+		if (argc == 2 && strcmp(argv[1], "init-race-child") == 0){
+			return initRaceChild();
+		}
+		if (argc == 2 && strcmp(argv[1], "scaling") == 0){
+			return scaling();
+		}
+	}
+	catch(exception& e){
+		cerr << e.what() << endl;
+		return 1;
+	}
+	cerr << "usage: " << argv[0] << " init-race|scaling" << endl;
+	return 2;
+}